@@ -150,6 +150,26 @@ typedef struct telnet_rfc1143_t {
 static const char CRLF[] = { '\r', '\n' };
 static const char CRNUL[] = { '\r', '\0' };
 
+/* bytes ending a run of regular data or text, a run ends on any of
+ * the first 1 (IAC), 2 (IAC, CR) or 3 (IAC, CR, LF) of them */
+static const unsigned char _scan_set[] = { TELNET_IAC, '\r', '\n' };
+#define _SCAN_IAC 1
+#define _SCAN_IAC_CR 2
+#define _SCAN_IAC_EOL 3
+
+/* skip a run of regular data or text up to a special byte */
+static const char *_scan(const char *p, const char *end, size_t n) {
+#if defined(TELNET_SCAN_HOOK)
+	return telnet_scan_hook(p, end, _scan_set, n);
+#else
+	for (; p != end; ++p) {
+		if (memchr(_scan_set, (unsigned char)*p, n) != 0)
+			break;
+	}
+	return p;
+#endif
+}
+
 /* buffer sizes */
 static const size_t _buffer_sizes[] = { 0, 512, 2048, 8192, 16384, };
 static const size_t _buffer_sizes_count = sizeof(_buffer_sizes) /
@@ -1015,6 +1035,16 @@ static void _process(telnet_t *telnet, const char *buffer, size_t size) {
 	unsigned char byte;
 	size_t i, start;
 	for (i = start = 0; i != size; ++i) {
+		/* skip regular data up to a next special byte */
+		if (telnet->state == TELNET_STATE_DATA) {
+			i = (size_t)(_scan(buffer + i, buffer + size,
+					(telnet->flags & TELNET_FLAG_NVT_EOL) &&
+					!(telnet->flags & TELNET_FLAG_RECEIVE_BINARY) ?
+					_SCAN_IAC_CR : _SCAN_IAC) - buffer);
+			if (i == size)
+				break;
+		}
+
 		byte = (unsigned char)buffer[i];
 		switch (telnet->state) {
 		/* regular data */
@@ -1374,6 +1404,12 @@ void telnet_send(telnet_t *telnet, const char *buffer,
 	size_t i, l;
 
 	for (l = i = 0; i != size; ++i) {
+		/* skip to a next IAC byte */
+		i = (size_t)(_scan(buffer + i, buffer + size, _SCAN_IAC) -
+				buffer);
+		if (i == size)
+			break;
+
 		/* dump prior portion of text, send escaped bytes */
 		if (buffer[i] == (char)TELNET_IAC) {
 			/* dump prior text if any */
@@ -1396,9 +1432,17 @@ void telnet_send(telnet_t *telnet, const char *buffer,
 /* send non-command text (escapes IAC bytes and does NVT translation) */
 void telnet_send_text(telnet_t *telnet, const char *buffer,
 		size_t size) {
+	const size_t set =
+			(telnet->flags & TELNET_FLAG_TRANSMIT_BINARY) ?
+			_SCAN_IAC : _SCAN_IAC_EOL;
 	size_t i, l;
 
 	for (l = i = 0; i != size; ++i) {
+		/* skip to a next byte to be escaped */
+		i = (size_t)(_scan(buffer + i, buffer + size, set) - buffer);
+		if (i == size)
+			break;
+
 		/* dump prior portion of text, send escaped bytes */
 		if (buffer[i] == (char)TELNET_IAC) {
 			/* dump prior text if any */
@@ -683,6 +683,23 @@ extern void telnet_zmp_arg(telnet_t *telnet, const char *arg);
  */
 #define telnet_finish_zmp(telnet) telnet_finish_sb((telnet))
 
+#if defined(TELNET_SCAN_HOOK)
+/*!
+ * \brief Find a special byte in a run of data, provided by an embedder.
+ *
+ * libtelnet calls this to skip runs of regular data and text when
+ * compiled with TELNET_SCAN_HOOK defined.
+ *
+ * \param p   Start of the run.
+ * \param end End of the run.
+ * \param set Special bytes.
+ * \param n   Number of special bytes, at most 3.
+ * \return The first byte of the run found in set, or end.
+ */
+extern const char *telnet_scan_hook(const char *p, const char *end,
+		const unsigned char *set, size_t n);
+#endif
+
 /* C++ support */
 #if defined(__cplusplus)
 } /* extern "C" */
@@ -0,0 +1,102 @@
+/* yxml_run() is kept out of the generated yxml.c, which is compiled here
+ * instead, as runs depend on parser states private to it. */
+
+#include "yxml.c"
+#include "yxml_run.h"
+
+/* A run ends at any byte yxml_parse() would not return as a single byte
+ * YXML_CONTENT or YXML_ATTRVAL token or would normalize first. */
+#define yxml_isRunContent(c) (c && c != '<' && c != '&' && c != 0xd)
+#define yxml_isRunCData(c) (c && c != ']' && c != 0xd)
+#define yxml_isRunAttValue(c) (yxml_isRunContent(c) && c != x->quote && c != 0x9 && c != 0xa)
+
+static const unsigned char yxml_runcontent[] = {'<', '&', 0xd, 0};
+static const unsigned char yxml_runcdata[] = {']', 0xd, 0};
+static const unsigned char yxml_runattrdq[] = {'"', '<', '&', 0x9, 0xa, 0xd, 0};
+static const unsigned char yxml_runattrsq[] = {'\'', '<', '&', 0x9, 0xa, 0xd, 0};
+
+#ifdef YXML_SCAN_HOOK
+/* Most runs are short values, so a few bytes are checked before the scan
+ * hook is called for the rest of a run. */
+#define YXML_RUNPREFIX 16
+#define yxml_scan yxml_scan_hook
+#else
+/* Without a scan hook a whole run is checked by the loops below. */
+#define YXML_RUNPREFIX ((size_t)-1)
+
+static const char *yxml_scan(const char *p, const char *end, const unsigned char *set, size_t n) {
+	for(; p != end && !memchr(set, (unsigned char)*p, n); p++)
+		;
+	return p;
+}
+#endif
+
+yxml_ret_t yxml_run(yxml_t *x, const char *s, size_t n, size_t *len) {
+	const unsigned char *p = (const unsigned char *)s;
+	const unsigned char *end = p + n;
+	const unsigned char *prefix = n > YXML_RUNPREFIX ? p + YXML_RUNPREFIX : end;
+	const unsigned char *nl = NULL;
+	const unsigned char *set;
+	size_t setlen;
+	const char *q;
+	yxml_ret_t ret;
+	unsigned ch;
+
+	*len = 0;
+
+	/* A '\n' following '\r' must be dropped by yxml_parse(). */
+	if(x->ignore)
+		return YXML_OK;
+
+	switch(x->state) {
+	case YXMLS_misc2:
+		for(; p != prefix && (ch = *p, yxml_isRunContent(ch)); p++)
+			if(ch == 0xa) {
+				x->line++;
+				nl = p;
+			}
+		set = yxml_runcontent;
+		setlen = sizeof(yxml_runcontent);
+		ret = YXML_CONTENT;
+		break;
+	case YXMLS_cd0:
+		for(; p != prefix && (ch = *p, yxml_isRunCData(ch)); p++)
+			if(ch == 0xa) {
+				x->line++;
+				nl = p;
+			}
+		set = yxml_runcdata;
+		setlen = sizeof(yxml_runcdata);
+		ret = YXML_CONTENT;
+		break;
+	case YXMLS_attr3:
+		for(; p != prefix && (ch = *p, yxml_isRunAttValue(ch)); p++)
+			;
+		set = x->quote == '"' ? yxml_runattrdq : yxml_runattrsq;
+		setlen = sizeof(yxml_runattrdq);
+		ret = YXML_ATTRVAL;
+		break;
+	default:
+		return YXML_OK;
+	}
+
+	if(p == prefix && p != end) {
+		q = (const char *)p;
+		p = (const unsigned char *)yxml_scan(q, (const char *)end, set, setlen);
+		if(ret == YXML_CONTENT)
+			for(; (q = memchr(q, 0xa, (size_t)((const char *)p - q))) != NULL; q++) {
+				x->line++;
+				nl = (const unsigned char *)q;
+			}
+	}
+
+	*len = (size_t)(p - (const unsigned char *)s);
+	if(!*len)
+		return YXML_OK;
+
+	x->total += *len;
+	x->byte = nl ? (uint64_t)(p - nl) : x->byte + *len;
+	return ret;
+}
+
+/* vim: set noet sw=4 ts=4: */
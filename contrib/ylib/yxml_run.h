@@ -0,0 +1,31 @@
+#ifndef YXML_RUN_H
+#define YXML_RUN_H
+
+#include "yxml.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Consumes a run of plain element content or attribute value bytes from the
+ * n bytes at s at once. The run is stored to *len and is equivalent to as
+ * many single byte YXML_CONTENT or YXML_ATTRVAL tokens returned by
+ * yxml_parse(), so it can be copied verbatim. Returns the token type, or
+ * YXML_OK with a zero *len if the next byte has to be given to yxml_parse().
+ * x->data is not changed. */
+yxml_ret_t yxml_run(yxml_t *, const char *, size_t, size_t *);
+
+#ifdef YXML_SCAN_HOOK
+/* Returns the first of the n bytes in set found in [p, end), or end. This is
+ * provided by an embedder to let yxml_run() skip the rest of a long run at
+ * once, n is at most 7. */
+const char *yxml_scan_hook(const char *p, const char *end, const unsigned char *set, size_t n);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* vim: set noet sw=4 ts=4: */
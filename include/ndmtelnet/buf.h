@@ -0,0 +1,105 @@
+#ifndef __NDM_BUF_H__
+#define __NDM_BUF_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "config.h"
+
+/**
+ * A byte queue with a contiguous view of unread data. A flat buffer moves
+ * unread data back to its start when the tail is exhausted. A mirrored
+ * buffer has its storage mapped twice in a row, so reads and writes just
+ * advance and wrap around without moving anything.
+ */
+
+struct ndm_buf_t {
+	char *ptr;		/* storage pointer */
+	char *r;		/* read position */
+	char *w;		/* write position */
+	size_t cap;		/* storage capacity */
+	bool mirror;	/* storage is mapped twice contiguously */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void
+ndm_buf_init(struct ndm_buf_t *b)
+{
+	b->ptr = NULL;
+	b->r = NULL;
+	b->w = NULL;
+	b->cap = 0;
+	b->mirror = false;
+}
+
+/**
+ * Allocates a buffer storage of at least @a cap bytes. A mirrored storage
+ * is rounded up to a page size, and a flat one is used when the platform
+ * does not support mirroring.
+ */
+
+bool ndm_buf_alloc(struct ndm_buf_t *b,
+				   const size_t cap,
+				   const bool mirror);
+
+void ndm_buf_free(struct ndm_buf_t *b);
+
+/**
+ * Moves unread data to a new storage of at least @a cap bytes keeping
+ * the storage kind. Fails if unread data does not fit the new storage.
+ */
+
+bool ndm_buf_resize(struct ndm_buf_t *b,
+					const size_t cap);
+
+/**
+ * Makes the buffer tail available for writing.
+ *
+ * @b Returns A size of contiguous free space at the write position.
+ */
+
+size_t ndm_buf_reserve(struct ndm_buf_t *b);
+
+static inline size_t
+ndm_buf_len(const struct ndm_buf_t *const b)
+{
+	return (size_t) (b->w - b->r);
+}
+
+static inline size_t
+ndm_buf_space(const struct ndm_buf_t *const b)
+{
+	if (b->mirror) {
+		return b->cap - (size_t) (b->w - b->r);
+	}
+
+	return (size_t) (b->ptr + b->cap - b->w);
+}
+
+static inline void
+ndm_buf_commit(struct ndm_buf_t *b, const size_t size)
+{
+	b->w += size;
+}
+
+static inline void
+ndm_buf_consume(struct ndm_buf_t *b, const size_t size)
+{
+	b->r += size;
+
+	if (b->r == b->w) {
+		b->r = b->ptr;
+		b->w = b->ptr;
+	} else if (b->mirror && b->r >= b->ptr + b->cap) {
+		b->r -= b->cap;
+		b->w -= b->cap;
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NDM_BUF_H__ */
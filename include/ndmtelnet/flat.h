@@ -0,0 +1,118 @@
+#ifndef __NDM_FLAT_H__
+#define __NDM_FLAT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "xml.h"
+
+/**
+ * A read-only document with nodes stored in a document order. Nodes refer
+ * to each other by indices, a root has a zero index. Attributes of a node
+ * are stored one after another, names and values are offsets of zero
+ * terminated strings in a common string buffer.
+ */
+
+#define NDM_XML_FLAT_NONE						UINT32_MAX
+
+struct ndm_xml_flat_node_t {
+	uint32_t parent;
+	uint32_t first_child;
+	uint32_t next;						/* a next sibling */
+	uint32_t attr;						/* a first attribute */
+	uint32_t attr_count;
+	uint32_t name;
+	uint32_t value;
+	uint32_t value_len;
+};
+
+struct ndm_xml_flat_attr_t {
+	uint32_t name;
+	uint32_t value;
+	uint32_t value_len;
+};
+
+struct ndm_xml_flat_t {
+	struct ndm_xml_flat_node_t *nodes;
+	uint32_t node_count;
+	size_t node_cap;
+	struct ndm_xml_flat_attr_t *attrs;
+	uint32_t attr_count;
+	size_t attr_cap;
+	char *strings;
+	size_t strings_size;
+	size_t strings_cap;
+	char *content;						/* values of open nodes */
+	size_t content_size;
+	size_t content_cap;
+	uint32_t open;						/* an innermost open node */
+	bool done;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ndm_xml_flat_init(struct ndm_xml_flat_t *flat);
+
+/**
+ * Drops a document keeping buffers of @a flat for a next one.
+ */
+
+void ndm_xml_flat_reset(struct ndm_xml_flat_t *flat);
+
+void ndm_xml_flat_free(struct ndm_xml_flat_t *flat);
+
+/**
+ * Parses @a text into @a flat with a parser state of @a dom like
+ * @c ndm_xml_sax_parse() does. @a done is set when a root element ends,
+ * a previous document of @a flat is dropped when a next one starts.
+ */
+
+enum ndm_xml_err_t ndm_xml_flat_parse(const char *const text,
+									  const size_t text_size,
+									  struct ndm_xml_dom_t *dom,
+									  struct ndm_xml_flat_t *flat,
+									  size_t *parsed_size,
+									  bool *done);
+
+/**
+ * @b Returns a root of a complete document or @c NDM_XML_FLAT_NONE.
+ */
+
+uint32_t ndm_xml_flat_root(const struct ndm_xml_flat_t *flat);
+
+const struct ndm_xml_flat_node_t *
+ndm_xml_flat_node(const struct ndm_xml_flat_t *flat,
+				  const uint32_t node);
+
+const char *ndm_xml_flat_name(const struct ndm_xml_flat_t *flat,
+							  const uint32_t node);
+
+const char *ndm_xml_flat_value(const struct ndm_xml_flat_t *flat,
+							   const uint32_t node);
+
+uint32_t ndm_xml_flat_find_child(const struct ndm_xml_flat_t *flat,
+								 const uint32_t node,
+								 const char *const name);
+
+uint32_t ndm_xml_flat_find_next(const struct ndm_xml_flat_t *flat,
+								const uint32_t node,
+								const char *const name);
+
+const struct ndm_xml_flat_attr_t *
+ndm_xml_flat_find_attr(const struct ndm_xml_flat_t *flat,
+					   const uint32_t node,
+					   const char *const name);
+
+const char *ndm_xml_flat_attr_name(const struct ndm_xml_flat_t *flat,
+								   const struct ndm_xml_flat_attr_t *attr);
+
+const char *ndm_xml_flat_attr_value(const struct ndm_xml_flat_t *flat,
+									const struct ndm_xml_flat_attr_t *attr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NDM_FLAT_H__ */
@@ -0,0 +1,151 @@
+#ifndef __NDM_QUERY_H__
+#define __NDM_QUERY_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "xml.h"
+
+/**
+ * A compiled path of element names relative to a document root, like
+ * "interface[@type='GigabitEthernet']/link". A step name may be "*",
+ * a step may have [@name] and [@name='value'] attribute predicates,
+ * and a last step may be "@name" to select an attribute value. Only
+ * attributes are checked, so a query is evaluated against a token
+ * stream as well as against a document.
+ */
+
+struct ndm_xml_query_t;
+
+/**
+ * A match of a query with a matched element of a document, or a null
+ * @a elem for a streamed one. A @a value is an element value or
+ * a selected attribute one, it is valid during a call only.
+ */
+
+typedef void (*ndm_xml_query_fn_t)(const struct ndm_xml_elem_t *elem,
+								   const char *value,
+								   const size_t value_len,
+								   void *data);
+
+/**
+ * A state of a query evaluated against a stream, see
+ * @c ndm_xml_query_sax().
+ */
+
+struct ndm_xml_query_eval_t {
+	const struct ndm_xml_query_t *query;
+	ndm_xml_query_fn_t fn;
+	void *data;
+	size_t matched;						/* matched open elements */
+	size_t pending;						/* an element with attributes */
+	size_t preds;						/* satisfied predicates */
+	bool selected;						/* an attribute is selected */
+	char *value;						/* a matched value */
+	size_t value_size;
+	size_t value_cap;
+	size_t matches;
+	bool lost;							/* a matched value is lost */
+	bool oom;
+};
+
+struct ndm_xml_filter_item_t;
+
+/**
+ * A set of queries selecting subtrees kept by @c ndm_xml_dom_parse(),
+ * see @c ndm_xml_dom_set_filter(). Elements on paths of queries and whole
+ * subtrees of matched elements are kept, other ones are skipped. A root
+ * element is always kept.
+ */
+
+struct ndm_xml_filter_t {
+	struct ndm_xml_filter_item_t *items;
+	size_t count;
+	size_t cap;
+	size_t depth;						/* kept open elements */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Compiles @a path into @a query released by @c ndm_xml_query_free().
+ * @b Returns @c NDM_XML_ERR_QUERY for a wrong path.
+ */
+
+enum ndm_xml_err_t ndm_xml_query_compile(const char *const path,
+										 struct ndm_xml_query_t **query);
+
+void ndm_xml_query_free(struct ndm_xml_query_t **query);
+
+/**
+ * Calls @a fn for each match of @a query in a document of @a root in
+ * a document order. @b Returns a number of matches.
+ */
+
+size_t ndm_xml_query_dom(const struct ndm_xml_query_t *query,
+						 const struct ndm_xml_elem_t *root,
+						 ndm_xml_query_fn_t fn,
+						 void *data);
+
+/**
+ * Prepares @a eval to call @a fn for each match of @a query in next
+ * streamed documents. @a eval is passed as callback data to
+ * @c ndm_xml_query_sax() callbacks.
+ */
+
+void ndm_xml_query_eval_init(struct ndm_xml_query_eval_t *eval,
+							 const struct ndm_xml_query_t *query,
+							 ndm_xml_query_fn_t fn,
+							 void *data);
+
+void ndm_xml_query_eval_free(struct ndm_xml_query_eval_t *eval);
+
+/**
+ * @b Returns callbacks evaluating a query of @c ndm_xml_query_eval_t
+ * data for @c ndm_xml_sax_parse() or @c ndm_telnet_recv_stream().
+ * Only a value of a current match is buffered. @a eval matches counts
+ * matches and @a eval oom is set if a value was lost for lack of memory.
+ */
+
+const struct ndm_xml_sax_t *ndm_xml_query_sax(void);
+
+void ndm_xml_filter_init(struct ndm_xml_filter_t *filter);
+
+/**
+ * Removes all queries of @a filter keeping its buffer.
+ */
+
+void ndm_xml_filter_clear(struct ndm_xml_filter_t *filter);
+
+void ndm_xml_filter_free(struct ndm_xml_filter_t *filter);
+
+/**
+ * Adds @a query to @a filter, it should outlive documents parsed with
+ * @a filter.
+ */
+
+enum ndm_xml_err_t ndm_xml_filter_add(struct ndm_xml_filter_t *filter,
+									  const struct ndm_xml_query_t *query);
+
+/**
+ * Document builder hooks. An element named @a name is started and
+ * @b true is returned if it may be kept. Then its attributes end and
+ * @b true is returned if @a elem is kept. Only kept elements are ended.
+ */
+
+void ndm_xml_filter_reset(struct ndm_xml_filter_t *filter);
+
+bool ndm_xml_filter_start(struct ndm_xml_filter_t *filter,
+						  const char *const name);
+
+bool ndm_xml_filter_attrs_end(struct ndm_xml_filter_t *filter,
+							  const struct ndm_xml_elem_t *elem);
+
+void ndm_xml_filter_end(struct ndm_xml_filter_t *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NDM_QUERY_H__ */
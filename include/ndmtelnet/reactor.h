@@ -0,0 +1,126 @@
+#ifndef __NDM_REACTOR_H__
+#define __NDM_REACTOR_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "telnet.h"
+
+/**
+ * A single-threaded engine driving many non-blocking telnet sessions.
+ * It waits for all sessions with a selected I/O backend, runs their
+ * handshakes, keeps a command queue per session
+ * and delivers responses through callbacks. All callbacks are called from
+ * @c ndm_telnet_reactor_run() and may send commands or remove sessions.
+ */
+
+struct ndm_telnet_reactor_t;
+struct ndm_telnet_session_t;
+
+enum ndm_telnet_reactor_backend_t
+{
+	NDM_TELNET_REACTOR_AUTO,
+	NDM_TELNET_REACTOR_POLL,
+	NDM_TELNET_REACTOR_EPOLL,
+	NDM_TELNET_REACTOR_URING
+};
+
+struct ndm_telnet_handler_t
+{
+	/* a session logged in and entered the raw mode */
+	void (*opened)(struct ndm_telnet_session_t *session,
+				   void *data);
+
+	/* a response to @a command or an event with a null @a command,
+	 * the callback may take @a response root setting it to null */
+	void (*response)(struct ndm_telnet_session_t *session,
+					 const char *command,
+					 struct ndm_telnet_response_t *response,
+					 void *data);
+
+	/* a session failed and is removed after the callback returns */
+	void (*closed)(struct ndm_telnet_session_t *session,
+				   const enum ndm_telnet_err_t err,
+				   void *data);
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_open(struct ndm_telnet_reactor_t **reactor);
+
+/**
+ * Opens a reactor with a preferred @a backend. An unavailable
+ * @c NDM_TELNET_REACTOR_URING falls back to @c NDM_TELNET_REACTOR_EPOLL
+ * and an unavailable epoll falls back to @c NDM_TELNET_REACTOR_POLL.
+ * @c NDM_TELNET_REACTOR_AUTO selects epoll. The io_uring backend receives
+ * directly into session buffers and submits all operations with a single
+ * system call per @c ndm_telnet_reactor_run().
+ */
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_open_ex(struct ndm_telnet_reactor_t **reactor,
+						   const enum ndm_telnet_reactor_backend_t backend);
+
+/**
+ * @b Returns a backend actually used by @a reactor.
+ */
+
+enum ndm_telnet_reactor_backend_t
+ndm_telnet_reactor_backend(const struct ndm_telnet_reactor_t *reactor);
+
+/**
+ * Closes all sessions without calling their handlers.
+ */
+
+void ndm_telnet_reactor_close(struct ndm_telnet_reactor_t **reactor);
+
+/**
+ * Starts connecting a new session. @c NDM_TELNET_FLAG_NON_BLOCKING is
+ * implied by the reactor, other options are as for
+ * @c ndm_telnet_open_ex(). @a timeout limits the handshake and waiting
+ * for each response. A null @a handler callback is ignored.
+ */
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_add(struct ndm_telnet_reactor_t *reactor,
+					   const struct sockaddr_in *const sin,
+					   const char *const login,
+					   const char *const password,
+					   const unsigned int timeout,
+					   const struct ndm_telnet_opts_t *opts,
+					   const struct ndm_telnet_handler_t *handler,
+					   void *data,
+					   struct ndm_telnet_session_t **session);
+
+void ndm_telnet_reactor_remove(struct ndm_telnet_session_t *session);
+
+/**
+ * Queues @a command. It is sent once the session is opened and less than
+ * @c NDM_TELNET_DEF_BATCH_WINDOW previous commands wait for responses.
+ */
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_send(struct ndm_telnet_session_t *session,
+						const char *const command);
+
+/**
+ * Waits for I/O at most @a timeout milliseconds, processes ready
+ * sessions and expires timed out ones.
+ */
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_run(struct ndm_telnet_reactor_t *reactor,
+					   const unsigned int timeout);
+
+size_t ndm_telnet_reactor_count(const struct ndm_telnet_reactor_t *reactor);
+
+struct ndm_telnet_t *
+ndm_telnet_session_telnet(const struct ndm_telnet_session_t *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NDM_REACTOR_H__ */
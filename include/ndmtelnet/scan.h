@@ -0,0 +1,45 @@
+#ifndef __NDM_SCAN_H__
+#define __NDM_SCAN_H__
+
+#include <stddef.h>
+#include "config.h"
+
+/**
+ * Kernels looking for a next special byte in XML and telnet streams.
+ * They skip ordinary bytes a vector at a time with SSE2 or AVX2 on x86
+ * and NEON on ARM. A kernel is selected at run time on a first call and
+ * a scalar one is used everywhere else.
+ */
+
+#define NDM_SCAN_SET_MAX						8
+
+struct ndm_scan_set_t {
+	unsigned char c[NDM_SCAN_SET_MAX];	/* special bytes */
+	unsigned int n;						/* number of special bytes */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @b Returns a pointer to a first byte from @a set in a range from @a p
+ * to @a end or @a end if there is no such byte.
+ */
+
+const char *ndm_scan(const char *p,
+					 const char *end,
+					 const struct ndm_scan_set_t *set);
+
+/**
+ * @b Returns a name of a selected kernel: "avx2", "sse2", "neon" or
+ * "scalar".
+ */
+
+const char *ndm_scan_kernel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NDM_SCAN_H__ */
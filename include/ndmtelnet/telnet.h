@@ -1,6 +1,7 @@
 #ifndef __NDM_TELNET_H__
 #define __NDM_TELNET_H__
 
+#include <stddef.h>
 #include <stdbool.h>
 #include "code.h"
 
@@ -13,10 +14,47 @@
 #define NDM_TELNET_MIN_TIMEOUT					1000
 #define NDM_TELNET_MAX_TIMEOUT					60000
 
+#define NDM_TELNET_DEF_BUFFER_SIZE				4096
+#define NDM_TELNET_MIN_BUFFER_SIZE				512
+#define NDM_TELNET_DEF_MAX_BUFFER_SIZE			262144
+
+#define NDM_TELNET_DEF_BATCH_WINDOW				16
+
+/* keep received data in a mirrored ring buffer if supported */
+#define NDM_TELNET_FLAG_RING_BUFFER				0x00000001
+
+/* never wait for I/O, see ndm_telnet_process() */
+#define NDM_TELNET_FLAG_NON_BLOCKING			0x00000002
+
+/* a non-blocking session leaves socket reads and writes to a caller */
+#define NDM_TELNET_FLAG_EXTERNAL_IO				0x00000004
+
+/* try to receive or send first and poll only when a socket is not ready */
+#define NDM_TELNET_FLAG_OPTIMISTIC_IO			0x00000008
+
+/* send credentials and enter the raw mode without waiting for prompts,
+ * a device should keep input typed ahead of them; only for devices known
+ * to ask for a login, as others run the credentials as commands and
+ * the handshake fails with NDM_TELNET_ERR_WRONG_STATE */
+#define NDM_TELNET_FLAG_FAST_OPEN				0x00000010
+
+/* response names and values point into a received text copy,
+ * see NDM_XML_DOM_FLAG_VIEWS */
+#define NDM_TELNET_FLAG_XML_VIEWS				0x00000020
+
+/* I/O readiness a non-blocking session waits for */
+#define NDM_TELNET_IO_READ						0x01
+#define NDM_TELNET_IO_WRITE						0x02
+
 struct sockaddr_in;
 
 struct ndm_telnet_t;
 struct ndm_xml_elem_t;
+struct ndm_xml_arena_t;
+struct ndm_xml_symtab_t;
+struct ndm_xml_sax_t;
+struct ndm_xml_token_t;
+struct ndm_xml_query_t;
 
 enum ndm_telnet_err_t
 {
@@ -51,7 +89,39 @@ enum ndm_telnet_err_t
 	NDM_TELNET_ERR_UNKNOWN_PROTOCOL,
 	NDM_TELNET_ERR_RAW_NOT_SUPPORTED,
 	NDM_TELNET_ERR_RAW_FAILED,
-	NDM_TELNET_ERR_DISCONNECTED
+	NDM_TELNET_ERR_DISCONNECTED,
+	NDM_TELNET_ERR_BUFFER_SIZE,
+	NDM_TELNET_ERR_AGAIN,
+	NDM_TELNET_ERR_WRONG_CALL
+};
+
+struct ndm_telnet_stats_t
+{
+	uint64_t commands;			/* commands queued to send */
+	uint64_t sends;				/* successful send() calls */
+	uint64_t bytes_sent;		/* bytes passed to send() */
+	uint64_t recvs;				/* successful recv() calls */
+	uint64_t bytes_received;	/* bytes returned by recv() */
+	uint64_t polls;				/* poll() calls */
+	uint64_t syscalls;			/* all poll(), send() and recv() calls */
+};
+
+struct ndm_telnet_opts_t
+{
+	unsigned int flags;			/* NDM_TELNET_FLAG_* bit set */
+	size_t buffer_size;			/* initial receive buffer size */
+	size_t max_buffer_size;		/* receive buffer growth limit */
+	struct ndm_xml_arena_t *arena;	/* response documents arena */
+	struct ndm_xml_symtab_t *symtab;	/* response names table */
+};
+
+struct ndm_telnet_response_t
+{
+	enum ndm_telnet_err_t err;
+	bool continued;
+	ndm_code_t code;
+	const char *text;
+	struct ndm_xml_elem_t *root;
 };
 
 #ifdef __cplusplus
@@ -64,6 +134,30 @@ enum ndm_telnet_err_t ndm_telnet_open(struct ndm_telnet_t **telnet,
 									  const char *const password,
 									  const unsigned int timeout);
 
+void ndm_telnet_opts_init(struct ndm_telnet_opts_t *opts);
+
+/**
+ * With a non-null @a opts arena all responses are built in it and are
+ * released by @c ndm_xml_arena_reset() only. The arena should not be
+ * reset while a non-blocking session receives a response partially.
+ * A non-null @a opts symtab should outlive all responses, it may be
+ * shared by sessions of one thread.
+ */
+
+enum ndm_telnet_err_t ndm_telnet_open_ex(struct ndm_telnet_t **telnet,
+										 const struct sockaddr_in *const sin,
+										 const char *const login,
+										 const char *const password,
+										 const unsigned int timeout,
+										 const struct ndm_telnet_opts_t *opts);
+
+/**
+ * Checks that @a command is not empty and has no newlines, so it may be
+ * queued and sent later.
+ */
+
+enum ndm_telnet_err_t ndm_telnet_check_command(const char *const command);
+
 enum ndm_telnet_err_t ndm_telnet_send(struct ndm_telnet_t *telnet,
 									  const char *const command,
 									  const unsigned int timeout);
@@ -75,8 +169,158 @@ enum ndm_telnet_err_t ndm_telnet_recv(struct ndm_telnet_t *telnet,
 									  struct ndm_xml_elem_t **response,
 									  const unsigned int timeout);
 
+/**
+ * Receives a next response like @c ndm_telnet_recv() building only nodes
+ * selected by @a queries and status nodes, see @c ndm_xml_dom_set_filter().
+ * With no @a queries a response document has status nodes only, so
+ * a status check does not build a response body. Events are filtered
+ * as well. @a queries should outlive a receive, and
+ * a partially received response is continued with queries it was started
+ * with.
+ */
+
+enum ndm_telnet_err_t
+ndm_telnet_recv_filtered(struct ndm_telnet_t *telnet,
+						 const struct ndm_xml_query_t *const *queries,
+						 const size_t query_count,
+						 bool *continued,
+						 ndm_code_t *response_code,
+						 const char **response_text,
+						 struct ndm_xml_elem_t **response,
+						 const unsigned int timeout);
+
+/**
+ * Receives a next response like @c ndm_telnet_recv() passing its nodes to
+ * @a sax callbacks with @a data instead of building a document, so any
+ * response is received in a constant memory. A null @a sax only checks
+ * a response status. @a response_text is valid until a next receive.
+ * A response received partially by @c ndm_telnet_recv() can not be
+ * continued by this function and vice versa.
+ */
+
+enum ndm_telnet_err_t ndm_telnet_recv_stream(struct ndm_telnet_t *telnet,
+											 const struct ndm_xml_sax_t *sax,
+											 void *data,
+											 bool *continued,
+											 ndm_code_t *response_code,
+											 const char **response_text,
+											 const unsigned int timeout);
+
+/**
+ * Pulls a next token of a response or an event receiving more data on
+ * demand. A token is valid until a next call. A response status is set
+ * with an end token of a root element only, @a response_text is null
+ * for other tokens. A partially pulled response is continued by this
+ * function only.
+ */
+
+enum ndm_telnet_err_t ndm_telnet_cursor_next(struct ndm_telnet_t *telnet,
+											 struct ndm_xml_token_t *token,
+											 bool *continued,
+											 ndm_code_t *response_code,
+											 const char **response_text,
+											 const unsigned int timeout);
+
+/**
+ * Skips the rest of an innermost open element of a pulled response, so
+ * a next token is its end one. Skipped nodes are not buffered unless they
+ * hold a response status.
+ */
+
+void ndm_telnet_cursor_skip(struct ndm_telnet_t *telnet);
+
+/**
+ * Sends @a count commands and receives their responses in order. At most
+ * @a window commands are written ahead of their responses, zero means
+ * @c NDM_TELNET_DEF_BATCH_WINDOW. Events and intermediate continued
+ * responses are skipped, so each command gets its final response only.
+ * A wrong format of a response or of any of its continued parts is
+ * reported in its @a err field, any other error stops the batch and is
+ * returned. Responses received before that are left in @a responses and
+ * should be released with @c ndm_telnet_batch_free().
+ */
+
+enum ndm_telnet_err_t ndm_telnet_exec_batch(struct ndm_telnet_t *telnet,
+											const char *const *commands,
+											const size_t count,
+											const size_t window,
+											struct ndm_telnet_response_t *responses,
+											const unsigned int timeout);
+
+void ndm_telnet_batch_free(struct ndm_telnet_response_t *responses,
+						   const size_t count);
+
+/**
+ * A non-blocking session opened with @c NDM_TELNET_FLAG_NON_BLOCKING is
+ * driven by an external event loop. @c ndm_telnet_open_ex() returns
+ * @c NDM_TELNET_ERR_AGAIN and a session which is being connected. Then
+ * the loop waits for @c ndm_telnet_interest() events on @c ndm_telnet_fd()
+ * until @c ndm_telnet_deadline() and calls @c ndm_telnet_process() after
+ * each wakeup.
+ *
+ * @c ndm_telnet_process() returns @c NDM_TELNET_ERR_OK when the session
+ * becomes ready with a null @a response root, or when a next response was
+ * received. It should be called again until it returns
+ * @c NDM_TELNET_ERR_AGAIN, because several responses may be buffered.
+ * Commands are queued with @c ndm_telnet_send() which never blocks.
+ * Any other error is fatal and the session should be closed.
+ */
+
+int ndm_telnet_fd(const struct ndm_telnet_t *telnet);
+
+/**
+ * @b Returns A @c NDM_TELNET_IO_* bit set.
+ */
+
+unsigned int ndm_telnet_interest(const struct ndm_telnet_t *telnet);
+
+/**
+ * @b Returns An absolute @c ndm_telnet_now() time of the current
+ * operation timeout or @c -1 if the session waits for nothing.
+ */
+
+int64_t ndm_telnet_deadline(const struct ndm_telnet_t *telnet);
+
+enum ndm_telnet_err_t ndm_telnet_process(struct ndm_telnet_t *telnet,
+										 struct ndm_telnet_response_t *response);
+
+/**
+ * With @c NDM_TELNET_FLAG_EXTERNAL_IO a caller receives data directly
+ * into a free receive buffer tail returned by @c ndm_telnet_recv_buffer()
+ * and passes its size to @c ndm_telnet_recv_commit(), zero means the peer
+ * closed a connection. The buffer stays valid until the commit. Pending
+ * output is taken with @c ndm_telnet_send_buffer() and dropped with
+ * @c ndm_telnet_send_commit() once sent. @c ndm_telnet_process() never
+ * reads or writes the socket then. A commit of more data than the buffer
+ * size or the pending output fails with @c NDM_TELNET_ERR_WRONG_CALL.
+ */
+
+enum ndm_telnet_err_t ndm_telnet_recv_buffer(struct ndm_telnet_t *telnet,
+											char **data,
+											size_t *size);
+
+enum ndm_telnet_err_t ndm_telnet_recv_commit(struct ndm_telnet_t *telnet,
+											const size_t size);
+
+/**
+ * Leaves a receive buffer returned by @c ndm_telnet_recv_buffer() to
+ * an external I/O which can not be stopped, it is never reused or freed
+ * by the session then.
+ */
+
+void ndm_telnet_recv_detach(struct ndm_telnet_t *telnet);
+
+size_t ndm_telnet_send_buffer(const struct ndm_telnet_t *telnet,
+							  const char **data);
+
+enum ndm_telnet_err_t ndm_telnet_send_commit(struct ndm_telnet_t *telnet,
+											const size_t size);
+
 void ndm_telnet_close(struct ndm_telnet_t **telnet);
 
+void ndm_telnet_get_stats(const struct ndm_telnet_t *telnet,
+						  struct ndm_telnet_stats_t *stats);
+
 const char *ndm_telnet_strerror(const enum ndm_telnet_err_t err);
 
 int64_t ndm_telnet_now();
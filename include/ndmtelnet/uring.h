@@ -0,0 +1,91 @@
+#ifndef __NDM_URING_H__
+#define __NDM_URING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+/**
+ * A minimal io_uring submission and completion queue pair used through
+ * raw system calls. It is available on Linux 5.11 or later only, and
+ * @c ndm_uring_init() fails everywhere else.
+ */
+
+struct ndm_uring_t {
+	int fd;					/* ring descriptor */
+	void *ring;				/* mapped queue rings */
+	size_t ring_size;		/* mapped rings size */
+	void *sqes;				/* mapped submission entries */
+	size_t sqes_size;		/* mapped entries size */
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	unsigned int tail;		/* local submission queue tail */
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	void *cqes;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool ndm_uring_init(struct ndm_uring_t *u,
+					const unsigned int entries);
+
+void ndm_uring_free(struct ndm_uring_t *u);
+
+/**
+ * Queue operations, they are submitted by a next @c ndm_uring_wait().
+ * A full submission queue is flushed first.
+ *
+ * @b Returns @c false if the operation can not be queued.
+ */
+
+bool ndm_uring_recv(struct ndm_uring_t *u,
+					const int fd,
+					void *data,
+					const size_t size,
+					const uint64_t user_data);
+
+bool ndm_uring_send(struct ndm_uring_t *u,
+					const int fd,
+					const void *data,
+					const size_t size,
+					const uint64_t user_data);
+
+bool ndm_uring_poll(struct ndm_uring_t *u,
+					const int fd,
+					const unsigned int events,
+					const uint64_t user_data);
+
+/**
+ * Cancels an operation queued with @a target user data. The cancel
+ * request completes with a zero user data.
+ */
+
+bool ndm_uring_cancel(struct ndm_uring_t *u,
+					  const uint64_t target);
+
+/**
+ * Submits queued operations and waits at most @a timeout milliseconds for
+ * a completion unless one is ready already.
+ *
+ * @b Returns @c false on a system call error.
+ */
+
+bool ndm_uring_wait(struct ndm_uring_t *u,
+					const int timeout);
+
+bool ndm_uring_peek(struct ndm_uring_t *u,
+					uint64_t *user_data,
+					int32_t *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NDM_URING_H__ */
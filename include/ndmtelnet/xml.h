@@ -2,15 +2,19 @@
 #define __NDM_XML_H__
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <ylib/yxml.h>
 
 struct ndm_xml_attr_t {
 	struct ndm_xml_attr_t *next;
 	struct ndm_xml_attr_t *prev;
 	char *value;
-	char name[1];
+	size_t value_len;
+	const char *name;
 };
 
+struct ndm_xml_index_t;
+
 struct ndm_xml_elem_t {
 	struct {
 		struct ndm_xml_attr_t *head;
@@ -23,12 +27,65 @@ struct ndm_xml_elem_t {
 	struct ndm_xml_elem_t *next;
 	struct ndm_xml_elem_t *prev;
 	struct ndm_xml_elem_t *parent;
+	struct ndm_xml_elem_t *next_same;	/* of an indexed parent */
+	struct ndm_xml_index_t *index;		/* children by name if any */
 	char *value;
-	char name[1];
+	size_t value_len;
+	const char *name;
 };
 
 #define NDM_XML_VALUE_ALLOC_STEP				1024
 
+/* names and values of documents point into a copy of parsed text,
+ * only values with references or line breaks are copied separately */
+#define NDM_XML_DOM_FLAG_VIEWS					0x00000001
+
+/* elements with more children are indexed by child names */
+#define NDM_XML_INDEX_MIN_CHILDREN				16
+
+#define NDM_XML_ARENA_CHUNK_SIZE				4096
+#define NDM_XML_ARENA_MAX_CHUNK_SIZE			1048576
+
+struct ndm_xml_chunk_t;
+
+/**
+ * A bump allocator keeping document nodes in a parse order. Documents
+ * parsed into a caller supplied arena are not released by
+ * @c ndm_xml_doc_free(), but all at once by @c ndm_xml_arena_reset().
+ */
+
+struct ndm_xml_arena_t {
+	struct ndm_xml_chunk_t *chunk;	/* a current chunk */
+	char *p;						/* a current chunk free space */
+	char *end;
+	size_t size;					/* a next chunk size */
+};
+
+/**
+ * A table of interned element and attribute names seeded with common NDM
+ * response names. Documents parsed with a table keep its symbols instead
+ * of name copies, so the table should outlive them. It may be shared by
+ * sessions of one thread.
+ */
+
+struct ndm_xml_symtab_t {
+	const char **slots;
+	size_t size;
+	size_t count;
+	struct ndm_xml_arena_t names;
+};
+
+struct ndm_xml_filter_t;
+
+/**
+ * A callback of @c ndm_xml_dom_parse() called when @a elem ends with its
+ * attributes, value and children, so a document may be inspected while
+ * it is being built.
+ */
+
+typedef void (*ndm_xml_dom_end_fn_t)(const struct ndm_xml_elem_t *elem,
+									 void *data);
+
 struct ndm_xml_value_t {
 	char static_data[NDM_XML_VALUE_ALLOC_STEP];
 	char *data;
@@ -43,6 +100,71 @@ struct ndm_xml_dom_t {
 	struct ndm_xml_elem_t *e;
 	struct ndm_xml_attr_t *a;
 	struct ndm_xml_value_t value;
+	struct ndm_xml_arena_t doc_arena;	/* a current document arena */
+	struct ndm_xml_arena_t *arena;		/* a caller arena if any */
+	size_t depth;						/* open elements of a stream */
+	size_t skip;						/* a skipped element depth + 1 */
+	unsigned int flags;					/* NDM_XML_DOM_FLAG_* bit set */
+	struct ndm_xml_elem_t **index_buf;	/* an index build table */
+	size_t index_size;
+	struct ndm_xml_symtab_t *symtab;	/* a name table if any */
+	struct ndm_xml_filter_t *filter;	/* kept subtrees if any */
+	struct ndm_xml_elem_t *check;		/* an element to filter */
+	size_t dropped;						/* open skipped elements */
+	ndm_xml_dom_end_fn_t end_fn;		/* an element end callback if any */
+	void *end_data;
+};
+
+/**
+ * Callbacks of a streamed document. A root element has a zero @a depth,
+ * attributes and content have a depth of their element. Content comes in
+ * chunks of any size which may point into parsed text. Names and values
+ * are valid during a callback only.
+ */
+
+struct ndm_xml_sax_t {
+	void (*elem_start)(const char *name,
+					   const size_t depth,
+					   void *data);
+
+	void (*attr)(const char *name,
+				 const char *value,
+				 const size_t value_len,
+				 const size_t depth,
+				 void *data);
+
+	void (*content)(const char *chunk,
+					const size_t size,
+					const size_t depth,
+					void *data);
+
+	void (*elem_end)(const char *name,
+					 const size_t depth,
+					 void *data);
+};
+
+enum ndm_xml_token_type_t
+{
+	NDM_XML_TOKEN_NONE,					/* more text is needed */
+	NDM_XML_TOKEN_ELEM_START,
+	NDM_XML_TOKEN_ATTR,
+	NDM_XML_TOKEN_CONTENT,
+	NDM_XML_TOKEN_ELEM_END
+};
+
+/**
+ * A token of a pulled document with the same @a depth as in
+ * @c ndm_xml_sax_t callbacks. Content chunks are not terminated by zero
+ * and may point into parsed text. A token is valid until a next call on
+ * its document.
+ */
+
+struct ndm_xml_token_t {
+	enum ndm_xml_token_type_t type;
+	const char *name;					/* an element or attribute name */
+	const char *value;					/* a value or a content chunk */
+	size_t value_len;
+	size_t depth;
 };
 
 enum ndm_xml_err_t
@@ -55,23 +177,145 @@ enum ndm_xml_err_t
 	NDM_XML_ERR_STACK							= 5, /* stack overflow */
 	NDM_XML_ERR_SYNTAX							= 6, /* syntax error */
 	NDM_XML_ERR_PI								= 7, /* PI node not supp. */
-	NDM_XML_ERR_INTERNAL						= 8  /* internal error */
+	NDM_XML_ERR_INTERNAL						= 8, /* internal error */
+	NDM_XML_ERR_QUERY							= 9  /* wrong query */
 };
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+void ndm_xml_arena_init(struct ndm_xml_arena_t *arena);
+
+/**
+ * Releases all documents allocated in @a arena keeping its last chunk
+ * for next documents.
+ */
+
+void ndm_xml_arena_reset(struct ndm_xml_arena_t *arena);
+
+void ndm_xml_arena_free(struct ndm_xml_arena_t *arena);
+
+void ndm_xml_symtab_init(struct ndm_xml_symtab_t *symtab);
+
+void ndm_xml_symtab_free(struct ndm_xml_symtab_t *symtab);
+
+/**
+ * @b Returns a symbol of a @a name_len long @a name adding it if needed,
+ * or null if out of memory.
+ */
+
+const char *ndm_xml_symtab_intern(struct ndm_xml_symtab_t *symtab,
+								  const char *const name,
+								  const size_t name_len);
+
+/**
+ * @b Returns a symbol of @a name or null if it was never interned, so no
+ * node of a document parsed with @a symtab has this name.
+ */
+
+const char *ndm_xml_symtab_find(struct ndm_xml_symtab_t *symtab,
+								const char *const name);
+
 void ndm_xml_dom_init(struct ndm_xml_dom_t *dom);
 
+/**
+ * Initializes @a dom to build documents in @a arena, or in a separate
+ * arena per document if @a arena is null.
+ */
+
+void ndm_xml_dom_init_ex(struct ndm_xml_dom_t *dom,
+						 struct ndm_xml_arena_t *arena);
+
+/**
+ * Sets @a flags for next documents of @a dom, an incomplete document
+ * should be reset before.
+ */
+
+void ndm_xml_dom_set_flags(struct ndm_xml_dom_t *dom,
+						   const unsigned int flags);
+
+/**
+ * Makes next documents of @a dom take names from @a symtab, or copy
+ * them if @a symtab is null.
+ */
+
+void ndm_xml_dom_set_symtab(struct ndm_xml_dom_t *dom,
+							struct ndm_xml_symtab_t *symtab);
+
+/**
+ * Makes next documents of @a dom keep only subtrees selected by @a filter,
+ * or whole documents if @a filter is null. Skipped nodes are validated,
+ * but not allocated. A filter applies to @c ndm_xml_dom_parse() only.
+ */
+
+void ndm_xml_dom_set_filter(struct ndm_xml_dom_t *dom,
+							struct ndm_xml_filter_t *filter);
+
+/**
+ * Makes @c ndm_xml_dom_parse() call @a fn with @a data for each built
+ * element of @a dom when it ends, a null @a fn disables calls.
+ */
+
+void ndm_xml_dom_set_end_fn(struct ndm_xml_dom_t *dom,
+							ndm_xml_dom_end_fn_t fn,
+							void *data);
+
+/**
+ * Drops an incomplete document and prepares @a dom for a next one keeping
+ * its buffers warm. @c ndm_xml_dom_parse() resets @a dom itself after
+ * each complete document.
+ */
+
+void ndm_xml_dom_reset(struct ndm_xml_dom_t *dom);
+
 enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 									 const size_t text_size,
 									 struct ndm_xml_dom_t *dom,
 									 size_t *parsed_size,
 									 struct ndm_xml_elem_t **root);
 
+/**
+ * Parses @a text like @c ndm_xml_dom_parse() calling @a sax callbacks
+ * instead of building a document. Only attribute values are buffered,
+ * so memory use does not depend on a document size. @a done is set when
+ * a root element ends. A null callback is ignored.
+ */
+
+enum ndm_xml_err_t ndm_xml_sax_parse(const char *const text,
+									 const size_t text_size,
+									 struct ndm_xml_dom_t *dom,
+									 const struct ndm_xml_sax_t *sax,
+									 void *data,
+									 size_t *parsed_size,
+									 bool *done);
+
+/**
+ * Parses @a text up to a next token. A @c NDM_XML_TOKEN_NONE token means
+ * all of @a text is parsed and a next part of a document is needed.
+ * @a dom is reset after an end token of a root element.
+ */
+
+enum ndm_xml_err_t ndm_xml_cursor_next(const char *const text,
+									   const size_t text_size,
+									   struct ndm_xml_dom_t *dom,
+									   size_t *parsed_size,
+									   struct ndm_xml_token_t *token);
+
+/**
+ * Makes @c ndm_xml_cursor_next() skip the rest of an innermost open element
+ * up to its end token without buffering its attributes and children.
+ */
+
+void ndm_xml_cursor_skip(struct ndm_xml_dom_t *dom);
+
 void ndm_xml_dom_free(struct ndm_xml_dom_t *dom);
 
+/**
+ * Releases a whole document at once, @a root should be a document root
+ * returned by @c ndm_xml_dom_parse().
+ */
+
 void ndm_xml_doc_free(struct ndm_xml_elem_t **root);
 
 struct ndm_xml_elem_t *
@@ -82,10 +326,45 @@ struct ndm_xml_elem_t *
 ndm_xml_elem_find_next(const struct ndm_xml_elem_t *const elem,
 					   const char *const name);
 
+/**
+ * @b Returns a next sibling of @a elem with the same name. Siblings of
+ * an indexed parent are linked, so iterating them does not depend on
+ * a number of other children.
+ */
+
+struct ndm_xml_elem_t *
+ndm_xml_elem_find_next_same(const struct ndm_xml_elem_t *const elem);
+
 struct ndm_xml_attr_t *
 ndm_xml_elem_find_attr(const struct ndm_xml_elem_t *const elem,
 					   const char *const name);
 
+/**
+ * Lookups by a @a sym symbol compare name pointers only, @a elem should
+ * be of a document parsed with the table @a sym is taken from.
+ */
+
+struct ndm_xml_elem_t *
+ndm_xml_elem_find_child_sym(const struct ndm_xml_elem_t *const elem,
+							const char *const sym);
+
+struct ndm_xml_elem_t *
+ndm_xml_elem_find_next_sym(const struct ndm_xml_elem_t *const elem,
+						   const char *const sym);
+
+struct ndm_xml_attr_t *
+ndm_xml_elem_find_attr_sym(const struct ndm_xml_elem_t *const elem,
+						   const char *const sym);
+
+/**
+ * @b Returns a value length without a terminating zero, values may be
+ * megabytes long.
+ */
+
+size_t ndm_xml_elem_value_len(const struct ndm_xml_elem_t *const elem);
+
+size_t ndm_xml_attr_value_len(const struct ndm_xml_attr_t *const attr);
+
 #ifdef __cplusplus
 }
 #endif
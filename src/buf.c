@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ndmtelnet/buf.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(SYS_memfd_create)
+#define NDM_BUF_HAS_MIRROR
+#endif
+#endif /* __linux__ */
+
+#ifdef NDM_BUF_HAS_MIRROR
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC								0x0001U
+#endif
+
+static char *__ndm_buf_mirror_alloc(size_t *cap)
+{
+	const long page = sysconf(_SC_PAGESIZE);
+	const size_t align = (page > 0) ? (size_t) page : 4096;
+	const size_t size = (*cap + align - 1) / align * align;
+	char *p = MAP_FAILED;
+	int fd = (int) syscall(SYS_memfd_create, "ndmtelnet", MFD_CLOEXEC);
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	if (ftruncate(fd, (off_t) size) != 0) {
+		goto error;
+	}
+
+	/* reserve a whole address range and map the storage twice over it */
+	p = (char *) mmap(NULL, 2 * size, PROT_NONE,
+					  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (p == MAP_FAILED) {
+		goto error;
+	}
+
+	if (mmap(p, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+		mmap(p + size, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(p, 2 * size);
+		p = MAP_FAILED;
+		goto error;
+	}
+
+	*cap = size;
+
+error:
+	close(fd);
+
+	return (p == MAP_FAILED) ? NULL : p;
+}
+
+static inline void __ndm_buf_mirror_free(char *p, const size_t cap)
+{
+	munmap(p, 2 * cap);
+}
+
+#else /* NDM_BUF_HAS_MIRROR */
+
+static char *__ndm_buf_mirror_alloc(size_t *cap)
+{
+	return NULL;
+}
+
+static inline void __ndm_buf_mirror_free(char *p, const size_t cap)
+{
+}
+
+#endif /* NDM_BUF_HAS_MIRROR */
+
+bool ndm_buf_alloc(struct ndm_buf_t *b,
+				   const size_t cap,
+				   const bool mirror)
+{
+	size_t size = cap;
+	char *p = NULL;
+	bool mirrored = false;
+
+	if (mirror) {
+		p = __ndm_buf_mirror_alloc(&size);
+		mirrored = (p != NULL);
+	}
+
+	if (p == NULL) {
+		size = cap;
+		p = (char *) malloc(size);
+
+		if (p == NULL) {
+			return false;
+		}
+	}
+
+	ndm_buf_free(b);
+
+	b->ptr = p;
+	b->r = p;
+	b->w = p;
+	b->cap = size;
+	b->mirror = mirrored;
+
+	return true;
+}
+
+void ndm_buf_free(struct ndm_buf_t *b)
+{
+	if (b->ptr != NULL) {
+		if (b->mirror) {
+			__ndm_buf_mirror_free(b->ptr, b->cap);
+		} else {
+			free(b->ptr);
+		}
+	}
+
+	ndm_buf_init(b);
+}
+
+bool ndm_buf_resize(struct ndm_buf_t *b,
+					const size_t cap)
+{
+	const size_t len = ndm_buf_len(b);
+	struct ndm_buf_t n;
+
+	if (cap < len) {
+		return false;
+	}
+
+	ndm_buf_init(&n);
+
+	if (!ndm_buf_alloc(&n, cap, b->mirror)) {
+		return false;
+	}
+
+	memcpy(n.ptr, b->r, len);
+	ndm_buf_commit(&n, len);
+	ndm_buf_free(b);
+	*b = n;
+
+	return true;
+}
+
+size_t ndm_buf_reserve(struct ndm_buf_t *b)
+{
+	if (!b->mirror && b->w == b->ptr + b->cap && b->r != b->ptr) {
+		const size_t len = ndm_buf_len(b);
+
+		/* move unread data to a buffer start */
+		memmove(b->ptr, b->r, len);
+		b->r = b->ptr;
+		b->w = b->ptr + len;
+	}
+
+	return ndm_buf_space(b);
+}
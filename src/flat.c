@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ndmtelnet/flat.h>
+
+#define NDM_XML_FLAT_MIN_CAP					64
+
+void ndm_xml_flat_init(struct ndm_xml_flat_t *flat)
+{
+	flat->nodes = NULL;
+	flat->node_cap = 0;
+	flat->attrs = NULL;
+	flat->attr_cap = 0;
+	flat->strings = NULL;
+	flat->strings_cap = 0;
+	flat->content = NULL;
+	flat->content_cap = 0;
+
+	ndm_xml_flat_reset(flat);
+}
+
+void ndm_xml_flat_reset(struct ndm_xml_flat_t *flat)
+{
+	flat->node_count = 0;
+	flat->attr_count = 0;
+	flat->strings_size = 0;
+	flat->content_size = 0;
+	flat->open = NDM_XML_FLAT_NONE;
+	flat->done = false;
+}
+
+void ndm_xml_flat_free(struct ndm_xml_flat_t *flat)
+{
+	free(flat->nodes);
+	free(flat->attrs);
+	free(flat->strings);
+	free(flat->content);
+
+	ndm_xml_flat_init(flat);
+}
+
+static bool __ndm_xml_flat_reserve(void **buf,
+								   size_t *cap,
+								   const size_t size,
+								   const size_t item_size)
+{
+	size_t c = (*cap == 0) ? NDM_XML_FLAT_MIN_CAP : *cap;
+	void *p;
+
+	if (size <= *cap) {
+		return true;
+	}
+
+	while (c < size) {
+		c *= 2;
+	}
+
+	p = realloc(*buf, c * item_size);
+
+	if (p == NULL) {
+		return false;
+	}
+
+	*buf = p;
+	*cap = c;
+
+	return true;
+}
+
+/* all strings are addressed by 32-bit offsets */
+static bool __ndm_xml_flat_string(struct ndm_xml_flat_t *flat,
+								  const char *const s,
+								  const size_t size,
+								  uint32_t *offset)
+{
+	const size_t end = flat->strings_size + size + 1;
+
+	if (end > UINT32_MAX ||
+		!__ndm_xml_flat_reserve((void **) &flat->strings,
+								&flat->strings_cap, end, 1)) {
+		return false;
+	}
+
+	if (size > 0) {
+		memcpy(flat->strings + flat->strings_size, s, size);
+	}
+
+	flat->strings[end - 1] = '\0';
+
+	*offset = (uint32_t) flat->strings_size;
+	flat->strings_size = end;
+
+	return true;
+}
+
+/* an open node keeps its last child in @a next and its value start
+ * in a content buffer in @a value */
+static bool __ndm_xml_flat_elem_start(struct ndm_xml_flat_t *flat,
+									  const char *const name)
+{
+	const uint32_t parent = flat->open;
+	const uint32_t i = flat->node_count;
+	struct ndm_xml_flat_node_t *n;
+
+	if (i == NDM_XML_FLAT_NONE ||
+		flat->content_size > UINT32_MAX ||
+		!__ndm_xml_flat_reserve((void **) &flat->nodes, &flat->node_cap,
+								(size_t) i + 1, sizeof(*n))) {
+		return false;
+	}
+
+	n = &flat->nodes[i];
+
+	if (!__ndm_xml_flat_string(flat, name, strlen(name), &n->name)) {
+		return false;
+	}
+
+	n->parent = parent;
+	n->first_child = NDM_XML_FLAT_NONE;
+	n->next = NDM_XML_FLAT_NONE;
+	n->attr = flat->attr_count;
+	n->attr_count = 0;
+	n->value = (uint32_t) flat->content_size;
+	n->value_len = 0;
+
+	if (parent != NDM_XML_FLAT_NONE) {
+		struct ndm_xml_flat_node_t *p = &flat->nodes[parent];
+
+		if (p->next == NDM_XML_FLAT_NONE) {
+			p->first_child = i;
+		} else {
+			flat->nodes[p->next].next = i;
+		}
+
+		p->next = i;
+	}
+
+	flat->node_count++;
+	flat->open = i;
+
+	return true;
+}
+
+static bool __ndm_xml_flat_attr(struct ndm_xml_flat_t *flat,
+								const char *const name,
+								const char *const value,
+								const size_t value_len)
+{
+	const uint32_t i = flat->attr_count;
+	struct ndm_xml_flat_attr_t *a;
+
+	if (i == NDM_XML_FLAT_NONE ||
+		!__ndm_xml_flat_reserve((void **) &flat->attrs, &flat->attr_cap,
+								(size_t) i + 1, sizeof(*a))) {
+		return false;
+	}
+
+	a = &flat->attrs[i];
+
+	if (!__ndm_xml_flat_string(flat, name, strlen(name), &a->name) ||
+		!__ndm_xml_flat_string(flat, value, value_len, &a->value)) {
+		return false;
+	}
+
+	a->value_len = (uint32_t) value_len;
+	flat->nodes[flat->open].attr_count++;
+	flat->attr_count++;
+
+	return true;
+}
+
+static bool __ndm_xml_flat_content(struct ndm_xml_flat_t *flat,
+								   const char *const chunk,
+								   const size_t size)
+{
+	if (!__ndm_xml_flat_reserve((void **) &flat->content,
+								&flat->content_cap,
+								flat->content_size + size, 1)) {
+		return false;
+	}
+
+	memcpy(flat->content + flat->content_size, chunk, size);
+	flat->content_size += size;
+
+	return true;
+}
+
+static bool __ndm_xml_flat_elem_end(struct ndm_xml_flat_t *flat)
+{
+	struct ndm_xml_flat_node_t *n = &flat->nodes[flat->open];
+	const size_t start = n->value;
+	const size_t size = flat->content_size - start;
+
+	if (!__ndm_xml_flat_string(flat, flat->content + start, size,
+							   &n->value)) {
+		return false;
+	}
+
+	n->value_len = (uint32_t) size;
+	n->next = NDM_XML_FLAT_NONE;
+	flat->content_size = start;
+	flat->open = n->parent;
+
+	return true;
+}
+
+enum ndm_xml_err_t ndm_xml_flat_parse(const char *const text,
+									  const size_t text_size,
+									  struct ndm_xml_dom_t *dom,
+									  struct ndm_xml_flat_t *flat,
+									  size_t *parsed_size,
+									  bool *done)
+{
+	size_t parsed = 0;
+	enum ndm_xml_err_t err = NDM_XML_ERR_OK;
+
+	*done = false;
+
+	while (!*done && parsed < text_size && err == NDM_XML_ERR_OK) {
+		struct ndm_xml_token_t token;
+		size_t size = 0;
+		bool added = true;
+
+		err = ndm_xml_cursor_next(text + parsed, text_size - parsed,
+								  dom, &size, &token);
+		parsed += size;
+
+		if (err != NDM_XML_ERR_OK) {
+			break;
+		}
+
+		switch (token.type) {
+			case NDM_XML_TOKEN_NONE: {
+				break;
+			}
+
+			case NDM_XML_TOKEN_ELEM_START: {
+				if (token.depth == 0) {
+					ndm_xml_flat_reset(flat);
+				}
+
+				added = __ndm_xml_flat_elem_start(flat, token.name);
+				break;
+			}
+
+			case NDM_XML_TOKEN_ATTR: {
+				added = __ndm_xml_flat_attr(flat, token.name,
+											token.value, token.value_len);
+				break;
+			}
+
+			case NDM_XML_TOKEN_CONTENT: {
+				added = __ndm_xml_flat_content(flat, token.value,
+											   token.value_len);
+				break;
+			}
+
+			case NDM_XML_TOKEN_ELEM_END: {
+				added = __ndm_xml_flat_elem_end(flat);
+				flat->done = (token.depth == 0);
+				*done = flat->done;
+				break;
+			}
+
+			default: {
+				err = NDM_XML_ERR_INTERNAL;
+				break;
+			}
+		}
+
+		if (!added) {
+			err = NDM_XML_ERR_NOMEM;
+		}
+	}
+
+	if (err != NDM_XML_ERR_OK) {
+		ndm_xml_flat_reset(flat);
+	}
+
+	*parsed_size = parsed;
+
+	return err;
+}
+
+uint32_t ndm_xml_flat_root(const struct ndm_xml_flat_t *flat)
+{
+	return (flat->done && flat->node_count > 0) ? 0 : NDM_XML_FLAT_NONE;
+}
+
+const struct ndm_xml_flat_node_t *
+ndm_xml_flat_node(const struct ndm_xml_flat_t *flat,
+				  const uint32_t node)
+{
+	return &flat->nodes[node];
+}
+
+const char *ndm_xml_flat_name(const struct ndm_xml_flat_t *flat,
+							  const uint32_t node)
+{
+	return flat->strings + flat->nodes[node].name;
+}
+
+const char *ndm_xml_flat_value(const struct ndm_xml_flat_t *flat,
+							   const uint32_t node)
+{
+	return flat->strings + flat->nodes[node].value;
+}
+
+static uint32_t __ndm_xml_flat_find(const struct ndm_xml_flat_t *flat,
+									uint32_t node,
+									const char *const name)
+{
+	while (node != NDM_XML_FLAT_NONE &&
+		   strcmp(flat->strings + flat->nodes[node].name, name) != 0) {
+		node = flat->nodes[node].next;
+	}
+
+	return node;
+}
+
+uint32_t ndm_xml_flat_find_child(const struct ndm_xml_flat_t *flat,
+								 const uint32_t node,
+								 const char *const name)
+{
+	return __ndm_xml_flat_find(flat, flat->nodes[node].first_child, name);
+}
+
+uint32_t ndm_xml_flat_find_next(const struct ndm_xml_flat_t *flat,
+								const uint32_t node,
+								const char *const name)
+{
+	return __ndm_xml_flat_find(flat, flat->nodes[node].next, name);
+}
+
+const struct ndm_xml_flat_attr_t *
+ndm_xml_flat_find_attr(const struct ndm_xml_flat_t *flat,
+					   const uint32_t node,
+					   const char *const name)
+{
+	const struct ndm_xml_flat_node_t *n = &flat->nodes[node];
+	const struct ndm_xml_flat_attr_t *a = flat->attrs + n->attr;
+	const struct ndm_xml_flat_attr_t *end = a + n->attr_count;
+
+	while (a < end) {
+		if (strcmp(flat->strings + a->name, name) == 0) {
+			return a;
+		}
+
+		a++;
+	}
+
+	return NULL;
+}
+
+const char *ndm_xml_flat_attr_name(const struct ndm_xml_flat_t *flat,
+								   const struct ndm_xml_flat_attr_t *attr)
+{
+	return flat->strings + attr->name;
+}
+
+const char *ndm_xml_flat_attr_value(const struct ndm_xml_flat_t *flat,
+									const struct ndm_xml_flat_attr_t *attr)
+{
+	return flat->strings + attr->value;
+}
@@ -0,0 +1,633 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ndmtelnet/query.h>
+
+#define NDM_XML_QUERY_VALUE_SIZE				256
+#define NDM_XML_FILTER_MIN_CAP					8
+
+struct ndm_xml_query_pred_t {
+	const char *attr;
+	const char *value;					/* null to check a presence */
+};
+
+struct ndm_xml_query_step_t {
+	const char *name;					/* null for any element */
+	const struct ndm_xml_query_pred_t *preds;
+	size_t pred_count;
+};
+
+/* steps, predicates and their strings are in a single block */
+struct ndm_xml_query_t {
+	const struct ndm_xml_query_step_t *steps;
+	size_t step_count;
+	const char *attr;					/* a selected attribute if any */
+};
+
+struct ndm_xml_filter_item_t {
+	const struct ndm_xml_query_t *query;
+	size_t matched;						/* matched open elements */
+	bool pending;						/* a started element is a candidate */
+};
+
+static inline bool __ndm_xml_query_is_name(const char c)
+{
+	return c != '\0' && strchr("/[]@='\"* \t\r\n", c) == NULL;
+}
+
+static inline char *__ndm_xml_query_str(char **strings,
+										const char *const s,
+										const size_t size)
+{
+	char *str = *strings;
+
+	memcpy(str, s, size);
+	str[size] = '\0';
+	*strings += size + 1;
+
+	return str;
+}
+
+/* @b Returns a name copy or null if there is no name at @a p */
+static inline const char *__ndm_xml_query_name(const char **p,
+											   char **strings)
+{
+	const char *s = *p;
+
+	while (__ndm_xml_query_is_name(**p)) {
+		(*p)++;
+	}
+
+	if (*p == s) {
+		return NULL;
+	}
+
+	return __ndm_xml_query_str(strings, s, (size_t) (*p - s));
+}
+
+static bool __ndm_xml_query_pred(const char **p,
+								 char **strings,
+								 struct ndm_xml_query_pred_t *pred)
+{
+	const char *s;
+	char quote;
+
+	if (**p != '@') {
+		return false;
+	}
+
+	(*p)++;
+
+	if ((pred->attr = __ndm_xml_query_name(p, strings)) == NULL) {
+		return false;
+	}
+
+	pred->value = NULL;
+
+	if (**p == '=') {
+		quote = *++(*p);
+
+		if (quote != '\'' && quote != '"') {
+			return false;
+		}
+
+		s = ++(*p);
+
+		if ((*p = strchr(s, quote)) == NULL) {
+			return false;
+		}
+
+		pred->value = __ndm_xml_query_str(strings, s, (size_t) (*p - s));
+		(*p)++;
+	}
+
+	if (**p != ']') {
+		return false;
+	}
+
+	(*p)++;
+
+	return true;
+}
+
+enum ndm_xml_err_t ndm_xml_query_compile(const char *const path,
+										 struct ndm_xml_query_t **query)
+{
+	const size_t path_size = strlen(path) + 1;
+	size_t step_count = 1;
+	size_t pred_count = 0;
+	struct ndm_xml_query_step_t *steps;
+	struct ndm_xml_query_pred_t *preds;
+	struct ndm_xml_query_t *q;
+	const char *p;
+	char *strings;
+
+	*query = NULL;
+
+	for (p = path; *p != '\0'; p++) {
+		if (*p == '/') {
+			step_count++;
+		} else if (*p == '[') {
+			pred_count++;
+		}
+	}
+
+	/* names and values are shorter than a path with delimiters */
+	q = (struct ndm_xml_query_t *)
+		malloc(sizeof(*q) + step_count * sizeof(*steps) +
+			   pred_count * sizeof(*preds) + path_size);
+
+	if (q == NULL) {
+		return NDM_XML_ERR_NOMEM;
+	}
+
+	steps = (struct ndm_xml_query_step_t *) (q + 1);
+	preds = (struct ndm_xml_query_pred_t *) (steps + step_count);
+	strings = (char *) (preds + pred_count);
+
+	q->steps = steps;
+	q->step_count = 0;
+	q->attr = NULL;
+	p = path;
+
+	for (;;) {
+		struct ndm_xml_query_step_t *s = &steps[q->step_count];
+
+		if (*p == '@') {
+			p++;
+
+			/* a selected attribute ends a path */
+			if ((q->attr = __ndm_xml_query_name(&p, &strings)) == NULL ||
+				*p != '\0' || q->step_count == 0) {
+				goto error;
+			}
+
+			break;
+		}
+
+		if (*p == '*') {
+			s->name = NULL;
+			p++;
+		} else if ((s->name = __ndm_xml_query_name(&p, &strings)) == NULL) {
+			goto error;
+		}
+
+		s->preds = preds;
+		s->pred_count = 0;
+
+		while (*p == '[') {
+			p++;
+
+			if (!__ndm_xml_query_pred(&p, &strings, preds++)) {
+				goto error;
+			}
+
+			s->pred_count++;
+		}
+
+		q->step_count++;
+
+		if (*p == '\0') {
+			break;
+		}
+
+		if (*p != '/') {
+			goto error;
+		}
+
+		p++;
+	}
+
+	*query = q;
+
+	return NDM_XML_ERR_OK;
+
+error:
+	free(q);
+
+	return NDM_XML_ERR_QUERY;
+}
+
+void ndm_xml_query_free(struct ndm_xml_query_t **query)
+{
+	if (query == NULL || *query == NULL) {
+		return;
+	}
+
+	free(*query);
+	*query = NULL;
+}
+
+static bool __ndm_xml_query_elem(const struct ndm_xml_query_step_t *s,
+								 const struct ndm_xml_elem_t *e)
+{
+	size_t i;
+
+	for (i = 0; i < s->pred_count; i++) {
+		const struct ndm_xml_query_pred_t *pred = &s->preds[i];
+		const struct ndm_xml_attr_t *a =
+			ndm_xml_elem_find_attr(e, pred->attr);
+
+		if (a == NULL ||
+			(pred->value != NULL && strcmp(a->value, pred->value) != 0)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static size_t __ndm_xml_query_dom(const struct ndm_xml_query_t *q,
+								  const struct ndm_xml_elem_t *parent,
+								  const size_t step,
+								  ndm_xml_query_fn_t fn,
+								  void *data)
+{
+	const struct ndm_xml_query_step_t *s = &q->steps[step];
+	const struct ndm_xml_elem_t *e;
+	size_t matches = 0;
+
+	/* named steps use child indexes of wide elements */
+	e = (s->name == NULL) ?
+		parent->children.head : ndm_xml_elem_find_child(parent, s->name);
+
+	while (e != NULL) {
+		if (__ndm_xml_query_elem(s, e)) {
+			if (step + 1 < q->step_count) {
+				matches += __ndm_xml_query_dom(q, e, step + 1, fn, data);
+			} else if (q->attr == NULL) {
+				fn(e, e->value, e->value_len, data);
+				matches++;
+			} else {
+				const struct ndm_xml_attr_t *a =
+					ndm_xml_elem_find_attr(e, q->attr);
+
+				if (a != NULL) {
+					fn(e, a->value, a->value_len, data);
+					matches++;
+				}
+			}
+		}
+
+		e = (s->name == NULL) ? e->next : ndm_xml_elem_find_next_same(e);
+	}
+
+	return matches;
+}
+
+size_t ndm_xml_query_dom(const struct ndm_xml_query_t *query,
+						 const struct ndm_xml_elem_t *root,
+						 ndm_xml_query_fn_t fn,
+						 void *data)
+{
+	return __ndm_xml_query_dom(query, root, 0, fn, data);
+}
+
+void ndm_xml_query_eval_init(struct ndm_xml_query_eval_t *eval,
+							 const struct ndm_xml_query_t *query,
+							 ndm_xml_query_fn_t fn,
+							 void *data)
+{
+	eval->query = query;
+	eval->fn = fn;
+	eval->data = data;
+	eval->matched = 0;
+	eval->pending = 0;
+	eval->preds = 0;
+	eval->selected = false;
+	eval->value = NULL;
+	eval->value_size = 0;
+	eval->value_cap = 0;
+	eval->matches = 0;
+	eval->lost = false;
+	eval->oom = false;
+}
+
+void ndm_xml_query_eval_free(struct ndm_xml_query_eval_t *eval)
+{
+	free(eval->value);
+	ndm_xml_query_eval_init(eval, eval->query, eval->fn, eval->data);
+}
+
+static void __ndm_xml_query_append(struct ndm_xml_query_eval_t *eval,
+								   const char *const s,
+								   const size_t size)
+{
+	/* a value is always terminated */
+	if (eval->value_size + size + 1 > eval->value_cap) {
+		size_t cap = (eval->value_cap == 0) ?
+			NDM_XML_QUERY_VALUE_SIZE : eval->value_cap;
+		char *value;
+
+		while (cap < eval->value_size + size + 1) {
+			cap *= 2;
+		}
+
+		value = (char *) realloc(eval->value, cap);
+
+		if (value == NULL) {
+			eval->lost = true;
+			eval->oom = true;
+			return;
+		}
+
+		eval->value = value;
+		eval->value_cap = cap;
+	}
+
+	memcpy(eval->value + eval->value_size, s, size);
+	eval->value_size += size;
+	eval->value[eval->value_size] = '\0';
+}
+
+static void __ndm_xml_query_emit(struct ndm_xml_query_eval_t *eval)
+{
+	/* an empty value still needs a buffer */
+	__ndm_xml_query_append(eval, "", 0);
+
+	if (!eval->lost) {
+		eval->fn(NULL, eval->value, eval->value_size, eval->data);
+		eval->matches++;
+	}
+
+	eval->value_size = 0;
+	eval->lost = false;
+}
+
+/* attributes of a candidate element end with a next token */
+static void __ndm_xml_query_attrs_end(struct ndm_xml_query_eval_t *eval)
+{
+	const struct ndm_xml_query_t *q = eval->query;
+
+	if (eval->pending == 0) {
+		return;
+	}
+
+	if (eval->preds == q->steps[eval->pending - 1].pred_count) {
+		eval->matched = eval->pending;
+
+		if (eval->matched == q->step_count && q->attr != NULL) {
+			if (eval->selected) {
+				__ndm_xml_query_emit(eval);
+			}
+		}
+	}
+
+	eval->pending = 0;
+	eval->value_size = 0;
+	eval->lost = false;
+}
+
+static void __ndm_xml_query_elem_start(const char *name,
+									   const size_t depth,
+									   void *data)
+{
+	struct ndm_xml_query_eval_t *eval = (struct ndm_xml_query_eval_t *) data;
+	const struct ndm_xml_query_t *q = eval->query;
+	const struct ndm_xml_query_step_t *s;
+
+	__ndm_xml_query_attrs_end(eval);
+
+	if (depth == 0) {
+		eval->matched = 0;
+		return;
+	}
+
+	if (depth != eval->matched + 1 || depth > q->step_count) {
+		return;
+	}
+
+	s = &q->steps[depth - 1];
+
+	if (s->name == NULL || strcmp(s->name, name) == 0) {
+		eval->pending = depth;
+		eval->preds = 0;
+		eval->selected = false;
+	}
+}
+
+static void __ndm_xml_query_attr(const char *name,
+								 const char *value,
+								 const size_t value_len,
+								 const size_t depth,
+								 void *data)
+{
+	struct ndm_xml_query_eval_t *eval = (struct ndm_xml_query_eval_t *) data;
+	const struct ndm_xml_query_t *q = eval->query;
+	const struct ndm_xml_query_step_t *s;
+	size_t i;
+
+	if (eval->pending == 0 || depth != eval->pending) {
+		return;
+	}
+
+	s = &q->steps[depth - 1];
+
+	for (i = 0; i < s->pred_count; i++) {
+		const struct ndm_xml_query_pred_t *pred = &s->preds[i];
+
+		if (strcmp(pred->attr, name) == 0 &&
+			(pred->value == NULL || strcmp(pred->value, value) == 0)) {
+			eval->preds++;
+		}
+	}
+
+	/* predicates may follow a selected attribute */
+	if (depth == q->step_count && q->attr != NULL &&
+		!eval->selected && strcmp(q->attr, name) == 0) {
+		__ndm_xml_query_append(eval, value, value_len);
+		eval->selected = true;
+	}
+}
+
+static void __ndm_xml_query_content(const char *chunk,
+									const size_t size,
+									const size_t depth,
+									void *data)
+{
+	struct ndm_xml_query_eval_t *eval = (struct ndm_xml_query_eval_t *) data;
+	const struct ndm_xml_query_t *q = eval->query;
+
+	__ndm_xml_query_attrs_end(eval);
+
+	if (depth == q->step_count && eval->matched == depth &&
+		q->attr == NULL) {
+		__ndm_xml_query_append(eval, chunk, size);
+	}
+}
+
+static void __ndm_xml_query_elem_end(const char *name,
+									 const size_t depth,
+									 void *data)
+{
+	struct ndm_xml_query_eval_t *eval = (struct ndm_xml_query_eval_t *) data;
+	const struct ndm_xml_query_t *q = eval->query;
+
+	__ndm_xml_query_attrs_end(eval);
+
+	if (depth == 0 || depth != eval->matched) {
+		return;
+	}
+
+	if (depth == q->step_count && q->attr == NULL) {
+		__ndm_xml_query_emit(eval);
+	}
+
+	eval->matched--;
+}
+
+static const struct ndm_xml_sax_t NDM_XML_QUERY_SAX = {
+	__ndm_xml_query_elem_start,
+	__ndm_xml_query_attr,
+	__ndm_xml_query_content,
+	__ndm_xml_query_elem_end
+};
+
+const struct ndm_xml_sax_t *ndm_xml_query_sax(void)
+{
+	return &NDM_XML_QUERY_SAX;
+}
+
+void ndm_xml_filter_init(struct ndm_xml_filter_t *filter)
+{
+	filter->items = NULL;
+	filter->count = 0;
+	filter->cap = 0;
+	filter->depth = 0;
+}
+
+void ndm_xml_filter_clear(struct ndm_xml_filter_t *filter)
+{
+	filter->count = 0;
+	filter->depth = 0;
+}
+
+void ndm_xml_filter_free(struct ndm_xml_filter_t *filter)
+{
+	free(filter->items);
+	ndm_xml_filter_init(filter);
+}
+
+enum ndm_xml_err_t ndm_xml_filter_add(struct ndm_xml_filter_t *filter,
+									  const struct ndm_xml_query_t *query)
+{
+	struct ndm_xml_filter_item_t *it;
+
+	if (filter->count == filter->cap) {
+		const size_t cap = (filter->cap == 0) ?
+			NDM_XML_FILTER_MIN_CAP : 2 * filter->cap;
+
+		it = (struct ndm_xml_filter_item_t *)
+			realloc(filter->items, cap * sizeof(*it));
+
+		if (it == NULL) {
+			return NDM_XML_ERR_NOMEM;
+		}
+
+		filter->items = it;
+		filter->cap = cap;
+	}
+
+	it = &filter->items[filter->count++];
+	it->query = query;
+	it->matched = 0;
+	it->pending = false;
+
+	return NDM_XML_ERR_OK;
+}
+
+void ndm_xml_filter_reset(struct ndm_xml_filter_t *filter)
+{
+	size_t i;
+
+	for (i = 0; i < filter->count; i++) {
+		filter->items[i].matched = 0;
+		filter->items[i].pending = false;
+	}
+
+	filter->depth = 0;
+}
+
+/* a root has a zero depth, so a step of an element is its depth - 1 */
+bool ndm_xml_filter_start(struct ndm_xml_filter_t *filter,
+						  const char *const name)
+{
+	const size_t depth = filter->depth;
+	bool keep = (depth == 0);
+	size_t i;
+
+	for (i = 0; i < filter->count; i++) {
+		struct ndm_xml_filter_item_t *it = &filter->items[i];
+		const struct ndm_xml_query_t *q = it->query;
+		const struct ndm_xml_query_step_t *s;
+
+		it->pending = false;
+
+		if (it->matched == q->step_count) {
+			/* a descendant of a matched element */
+			keep = true;
+			continue;
+		}
+
+		if (depth == 0 || it->matched + 1 != depth) {
+			continue;
+		}
+
+		s = &q->steps[depth - 1];
+
+		if (s->name == NULL || strcmp(s->name, name) == 0) {
+			it->pending = true;
+			keep = true;
+		}
+	}
+
+	return keep;
+}
+
+bool ndm_xml_filter_attrs_end(struct ndm_xml_filter_t *filter,
+							  const struct ndm_xml_elem_t *elem)
+{
+	const size_t depth = filter->depth;
+	bool keep = (depth == 0);
+	size_t i;
+
+	for (i = 0; i < filter->count; i++) {
+		struct ndm_xml_filter_item_t *it = &filter->items[i];
+		const struct ndm_xml_query_t *q = it->query;
+
+		if (it->pending) {
+			it->pending = false;
+
+			if (__ndm_xml_query_elem(&q->steps[depth - 1], elem)) {
+				it->matched = depth;
+				keep = true;
+			}
+		} else if (it->matched == q->step_count) {
+			keep = true;
+		}
+	}
+
+	if (keep) {
+		filter->depth++;
+	}
+
+	return keep;
+}
+
+void ndm_xml_filter_end(struct ndm_xml_filter_t *filter)
+{
+	const size_t depth = --filter->depth;
+	size_t i;
+
+	if (depth == 0) {
+		return;
+	}
+
+	for (i = 0; i < filter->count; i++) {
+		struct ndm_xml_filter_item_t *it = &filter->items[i];
+
+		if (it->matched >= depth) {
+			it->matched = depth - 1;
+		}
+	}
+}
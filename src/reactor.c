@@ -0,0 +1,996 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ylib/list.h>
+#include <ndmtelnet/xml.h>
+#include <ndmtelnet/str.h>
+#include <ndmtelnet/uring.h>
+#include <ndmtelnet/telnet.h>
+#include <ndmtelnet/reactor.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <WinSock2.h>
+
+#define close									closesocket
+#define poll									WSAPoll
+#define SHUT_RDWR								SD_BOTH
+
+typedef ULONG nfds_t;
+
+#else /* _WIN32 || _WIN64 */
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#endif /* _WIN32 || _WIN64 */
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+
+#define NDM_TELNET_HAS_EPOLL
+#endif /* __linux__ */
+
+#define NDM_TELNET_REACTOR_EVENTS				256
+#define NDM_TELNET_REACTOR_URING_ENTRIES		4096
+#define NDM_TELNET_REACTOR_URING_DRAIN			100
+
+/* an io_uring operation kind is kept in low session pointer bits */
+#define NDM_TELNET_URING_RECV					0
+#define NDM_TELNET_URING_SEND					1
+#define NDM_TELNET_URING_POLL					2
+#define NDM_TELNET_URING_MASK					3
+
+#define NDM_TELNET_TX_STP						256
+
+struct ndm_telnet_cmd_t {
+	struct ndm_telnet_cmd_t *next;
+	struct ndm_telnet_cmd_t *prev;
+	char text[1];
+};
+
+struct ndm_telnet_cmd_list_t {
+	struct ndm_telnet_cmd_t *head;
+	struct ndm_telnet_cmd_t *tail;
+};
+
+struct ndm_telnet_session_t {
+	struct ndm_telnet_session_t *next;
+	struct ndm_telnet_session_t *prev;
+	struct ndm_telnet_reactor_t *reactor;
+	struct ndm_telnet_t *telnet;
+	struct ndm_telnet_handler_t handler;
+	void *data;
+	unsigned int timeout;
+	unsigned int interest;
+	bool opened;
+	bool removed;
+	size_t inflight;
+	struct ndm_telnet_cmd_list_t queued;	/* commands to send */
+	struct ndm_telnet_cmd_list_t sent;		/* commands waiting responses */
+	unsigned int ops;						/* io_uring operations */
+	bool recv_armed;
+	bool send_armed;
+	bool poll_armed;
+	char *rx;								/* io_uring receive buffer */
+	size_t rx_size;
+	struct ndm_str_t tx;					/* io_uring send buffer */
+	size_t tx_off;
+};
+
+struct ndm_telnet_session_list_t {
+	struct ndm_telnet_session_t *head;
+	struct ndm_telnet_session_t *tail;
+};
+
+struct ndm_telnet_reactor_t {
+	struct ndm_telnet_session_list_t sessions;
+	size_t count;
+	bool running;
+	bool has_removed;
+	enum ndm_telnet_reactor_backend_t backend;
+	int epfd;
+	struct ndm_uring_t uring;
+	struct pollfd *pfds;
+	struct ndm_telnet_session_t **pfd_sessions;
+	size_t pfds_cap;
+};
+
+static void __ndm_telnet_session_process(struct ndm_telnet_session_t *s);
+
+static void __ndm_telnet_cmd_list_free(struct ndm_telnet_cmd_list_t *l)
+{
+	while (l->head != NULL) {
+		struct ndm_telnet_cmd_t *c = l->head;
+
+		list_remove(*l, c);
+		free(c);
+	}
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_epoll_watch(struct ndm_telnet_session_t *s)
+{
+#ifdef NDM_TELNET_HAS_EPOLL
+	const unsigned int interest = ndm_telnet_interest(s->telnet);
+	struct epoll_event ev;
+
+	if (interest == s->interest) {
+		return NDM_TELNET_ERR_OK;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.ptr = s;
+
+	if (interest & NDM_TELNET_IO_READ) {
+		ev.events |= EPOLLIN;
+	}
+
+	if (interest & NDM_TELNET_IO_WRITE) {
+		ev.events |= EPOLLOUT;
+	}
+
+	if (epoll_ctl(s->reactor->epfd,
+				  (s->interest == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+				  ndm_telnet_fd(s->telnet), &ev) != 0) {
+		return NDM_TELNET_ERR_IO_ERROR;
+	}
+
+	s->interest = interest;
+#endif /* NDM_TELNET_HAS_EPOLL */
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static inline uint64_t
+__ndm_telnet_uring_data(const struct ndm_telnet_session_t *s,
+						const unsigned int op)
+{
+	return (uint64_t) (uintptr_t) s | op;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_uring_send(struct ndm_telnet_session_t *s)
+{
+	if (!ndm_uring_send(&s->reactor->uring, ndm_telnet_fd(s->telnet),
+						ndm_str_ptr(&s->tx) + s->tx_off,
+						ndm_str_len(&s->tx) - s->tx_off,
+						__ndm_telnet_uring_data(s, NDM_TELNET_URING_SEND))) {
+		return NDM_TELNET_ERR_IO_ERROR;
+	}
+
+	s->send_armed = true;
+	s->ops++;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_uring_recv(struct ndm_telnet_session_t *s)
+{
+	if (!ndm_uring_recv(&s->reactor->uring, ndm_telnet_fd(s->telnet),
+						s->rx, s->rx_size,
+						__ndm_telnet_uring_data(s, NDM_TELNET_URING_RECV))) {
+		return NDM_TELNET_ERR_IO_ERROR;
+	}
+
+	s->recv_armed = true;
+	s->ops++;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_uring_watch(struct ndm_telnet_session_t *s)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	const char *data = NULL;
+	size_t size = 0;
+
+	if (!(ndm_telnet_interest(s->telnet) & NDM_TELNET_IO_READ)) {
+		/* a connection is in progress */
+		if (!s->poll_armed) {
+			if (!ndm_uring_poll(&s->reactor->uring,
+								ndm_telnet_fd(s->telnet), POLLOUT,
+								__ndm_telnet_uring_data(s,
+									NDM_TELNET_URING_POLL))) {
+				return NDM_TELNET_ERR_IO_ERROR;
+			}
+
+			s->poll_armed = true;
+			s->ops++;
+		}
+
+		return NDM_TELNET_ERR_OK;
+	}
+
+	/* data is received directly into a session buffer */
+	if (!s->recv_armed) {
+		err = ndm_telnet_recv_buffer(s->telnet, &s->rx, &s->rx_size);
+
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
+		}
+
+		err = __ndm_telnet_uring_recv(s);
+
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
+		}
+	}
+
+	if (s->send_armed) {
+		return NDM_TELNET_ERR_OK;
+	}
+
+	size = ndm_telnet_send_buffer(s->telnet, &data);
+
+	if (size == 0) {
+		return NDM_TELNET_ERR_OK;
+	}
+
+	/* session output may grow while it is being sent */
+	ndm_str_clear(&s->tx);
+
+	if (!ndm_str_append(&s->tx, data, size)) {
+		return NDM_TELNET_ERR_OOM;
+	}
+
+	/* output is dropped as completions report it sent */
+	s->tx_off = 0;
+
+	return __ndm_telnet_uring_send(s);
+}
+
+static void __ndm_telnet_uring_cancel(struct ndm_telnet_session_t *s)
+{
+	struct ndm_uring_t *u = &s->reactor->uring;
+
+	if (s->recv_armed) {
+		ndm_uring_cancel(u, __ndm_telnet_uring_data(s,
+			NDM_TELNET_URING_RECV));
+	}
+
+	if (s->send_armed) {
+		ndm_uring_cancel(u, __ndm_telnet_uring_data(s,
+			NDM_TELNET_URING_SEND));
+	}
+
+	if (s->poll_armed) {
+		ndm_uring_cancel(u, __ndm_telnet_uring_data(s,
+			NDM_TELNET_URING_POLL));
+	}
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_session_watch(struct ndm_telnet_session_t *s)
+{
+	switch (s->reactor->backend) {
+		case NDM_TELNET_REACTOR_URING: {
+			return __ndm_telnet_uring_watch(s);
+		}
+
+		case NDM_TELNET_REACTOR_EPOLL: {
+			return __ndm_telnet_epoll_watch(s);
+		}
+
+		case NDM_TELNET_REACTOR_AUTO:
+		case NDM_TELNET_REACTOR_POLL:
+		default: {
+			/* poll() descriptors are rebuilt on each wait */
+			return NDM_TELNET_ERR_OK;
+		}
+	}
+}
+
+static void __ndm_telnet_session_free(struct ndm_telnet_session_t *s)
+{
+#ifdef NDM_TELNET_HAS_EPOLL
+	if (s->reactor->backend == NDM_TELNET_REACTOR_EPOLL &&
+		s->interest != 0) {
+		struct epoll_event ev;
+
+		epoll_ctl(s->reactor->epfd, EPOLL_CTL_DEL,
+				  ndm_telnet_fd(s->telnet), &ev);
+	}
+#endif /* NDM_TELNET_HAS_EPOLL */
+
+	ndm_telnet_close(&s->telnet);
+	__ndm_telnet_cmd_list_free(&s->queued);
+	__ndm_telnet_cmd_list_free(&s->sent);
+	ndm_str_free(&s->tx);
+	free(s);
+}
+
+static void __ndm_telnet_reactor_sweep(struct ndm_telnet_reactor_t *reactor)
+{
+	struct ndm_telnet_session_t *s = reactor->sessions.head;
+
+	if (!reactor->has_removed) {
+		return;
+	}
+
+	reactor->has_removed = false;
+
+	while (s != NULL) {
+		struct ndm_telnet_session_t *next = s->next;
+
+		if (s->removed) {
+			if (s->ops == 0) {
+				list_remove(reactor->sessions, s);
+				__ndm_telnet_session_free(s);
+			} else {
+				/* wait for cancelled io_uring operations */
+				reactor->has_removed = true;
+			}
+		}
+
+		s = next;
+	}
+}
+
+static void __ndm_telnet_session_fail(struct ndm_telnet_session_t *s,
+									  const enum ndm_telnet_err_t err)
+{
+	if (s->handler.closed != NULL) {
+		s->handler.closed(s, err, s->data);
+	}
+
+	ndm_telnet_reactor_remove(s);
+}
+
+static void __ndm_telnet_uring_complete(const uint64_t user_data,
+										const int32_t res)
+{
+	struct ndm_telnet_session_t *s = (struct ndm_telnet_session_t *)
+		(uintptr_t) (user_data & ~((uint64_t) NDM_TELNET_URING_MASK));
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	const bool again = (res == -EAGAIN || res == -EINTR);
+
+	if (s == NULL) {
+		/* a cancel request completion */
+		return;
+	}
+
+	s->ops--;
+
+	switch (user_data & NDM_TELNET_URING_MASK) {
+		case NDM_TELNET_URING_RECV: {
+			s->recv_armed = false;
+
+			if (s->removed) {
+				break;
+			}
+
+			if (again) {
+				/* the receive buffer is still reserved */
+				err = __ndm_telnet_uring_recv(s);
+				break;
+			}
+
+			if (res < 0) {
+				err = NDM_TELNET_ERR_IO_ERROR;
+				break;
+			}
+
+			err = ndm_telnet_recv_commit(s->telnet, (size_t) res);
+
+			if (err == NDM_TELNET_ERR_OK) {
+				__ndm_telnet_session_process(s);
+			}
+
+			break;
+		}
+
+		case NDM_TELNET_URING_SEND: {
+			s->send_armed = false;
+
+			if (s->removed) {
+				break;
+			}
+
+			if (!again && res < 0) {
+				err = NDM_TELNET_ERR_SEND;
+				break;
+			}
+
+			if (res > 0) {
+				s->tx_off += (size_t) res;
+				err = ndm_telnet_send_commit(s->telnet, (size_t) res);
+
+				if (err != NDM_TELNET_ERR_OK) {
+					break;
+				}
+			}
+
+			if (s->tx_off < ndm_str_len(&s->tx)) {
+				err = __ndm_telnet_uring_send(s);
+				break;
+			}
+
+			/* a handshake waits for its output to be sent */
+			__ndm_telnet_session_process(s);
+			break;
+		}
+
+		case NDM_TELNET_URING_POLL: {
+			s->poll_armed = false;
+
+			if (!s->removed) {
+				__ndm_telnet_session_process(s);
+			}
+
+			break;
+		}
+
+		default: {
+			break;
+		}
+	}
+
+	if (err != NDM_TELNET_ERR_OK && !s->removed) {
+		__ndm_telnet_session_fail(s, err);
+	}
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_session_pump(struct ndm_telnet_session_t *s)
+{
+	while (s->opened &&
+		   s->queued.head != NULL &&
+		   s->inflight < NDM_TELNET_DEF_BATCH_WINDOW) {
+		struct ndm_telnet_cmd_t *c = s->queued.head;
+		const enum ndm_telnet_err_t err =
+			ndm_telnet_send(s->telnet, c->text, s->timeout);
+
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
+		}
+
+		list_remove(s->queued, c);
+		list_append(s->sent, c);
+		s->inflight++;
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static void __ndm_telnet_session_deliver(struct ndm_telnet_session_t *s,
+										 struct ndm_telnet_response_t *r)
+{
+	struct ndm_telnet_cmd_t *c = s->sent.head;
+	const bool event =
+		r->root != NULL && strcmp(r->root->name, "event") == 0;
+	const char *command = (c == NULL || event) ? NULL : c->text;
+
+	if (s->handler.response != NULL) {
+		s->handler.response(s, command, r, s->data);
+	}
+
+	ndm_xml_doc_free(&r->root);
+
+	if (command != NULL && !r->continued) {
+		/* a final response to the oldest command */
+		list_remove(s->sent, c);
+		free(c);
+		s->inflight--;
+	}
+}
+
+static void __ndm_telnet_session_process(struct ndm_telnet_session_t *s)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	while (!s->removed) {
+		struct ndm_telnet_response_t r;
+
+		err = ndm_telnet_process(s->telnet, &r);
+
+		if (err == NDM_TELNET_ERR_AGAIN) {
+			err = __ndm_telnet_session_watch(s);
+			break;
+		}
+
+		if (err != NDM_TELNET_ERR_OK) {
+			break;
+		}
+
+		if (!s->opened) {
+			s->opened = true;
+
+			if (s->handler.opened != NULL) {
+				s->handler.opened(s, s->data);
+			}
+		} else {
+			__ndm_telnet_session_deliver(s, &r);
+		}
+
+		if (!s->removed) {
+			err = __ndm_telnet_session_pump(s);
+
+			if (err != NDM_TELNET_ERR_OK) {
+				break;
+			}
+		}
+	}
+
+	if (err != NDM_TELNET_ERR_OK && !s->removed) {
+		__ndm_telnet_session_fail(s, err);
+	}
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_poll_wait(struct ndm_telnet_reactor_t *reactor,
+					   const int timeout)
+{
+	struct ndm_telnet_session_t *s;
+	size_t n = 0;
+	size_t i;
+	int ret;
+
+	if (reactor->pfds_cap < reactor->count) {
+		const size_t cap = 2 * reactor->count;
+		struct pollfd *pfds = (struct pollfd *)
+			realloc(reactor->pfds, cap * sizeof(*pfds));
+		struct ndm_telnet_session_t **pfd_sessions;
+
+		if (pfds == NULL) {
+			return NDM_TELNET_ERR_OOM;
+		}
+
+		reactor->pfds = pfds;
+		pfd_sessions = (struct ndm_telnet_session_t **)
+			realloc(reactor->pfd_sessions, cap * sizeof(*pfd_sessions));
+
+		if (pfd_sessions == NULL) {
+			return NDM_TELNET_ERR_OOM;
+		}
+
+		reactor->pfd_sessions = pfd_sessions;
+		reactor->pfds_cap = cap;
+	}
+
+	for (s = reactor->sessions.head; s != NULL; s = s->next) {
+		struct pollfd *pfd = &reactor->pfds[n];
+		unsigned int interest;
+
+		if (s->removed) {
+			continue;
+		}
+
+		interest = ndm_telnet_interest(s->telnet);
+		pfd->fd = ndm_telnet_fd(s->telnet);
+		pfd->events = 0;
+		pfd->revents = 0;
+
+		if (interest & NDM_TELNET_IO_READ) {
+			pfd->events |= POLLIN;
+		}
+
+		if (interest & NDM_TELNET_IO_WRITE) {
+			pfd->events |= POLLOUT;
+		}
+
+		reactor->pfd_sessions[n++] = s;
+	}
+
+	ret = poll(reactor->pfds, (nfds_t) n, timeout);
+
+	if (ret < 0) {
+		return (errno == EINTR) ?
+			NDM_TELNET_ERR_OK :
+			NDM_TELNET_ERR_IO_ERROR;
+	}
+
+	for (i = 0; i < n && ret > 0; i++) {
+		if (reactor->pfds[i].revents == 0) {
+			continue;
+		}
+
+		ret--;
+		s = reactor->pfd_sessions[i];
+
+		if (!s->removed) {
+			__ndm_telnet_session_process(s);
+		}
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_epoll_wait(struct ndm_telnet_reactor_t *reactor,
+						const int timeout)
+{
+#ifdef NDM_TELNET_HAS_EPOLL
+	struct epoll_event events[NDM_TELNET_REACTOR_EVENTS];
+	const int n = epoll_wait(reactor->epfd, events,
+							 NDM_TELNET_REACTOR_EVENTS, timeout);
+	int i;
+
+	if (n < 0) {
+		return (errno == EINTR) ?
+			NDM_TELNET_ERR_OK :
+			NDM_TELNET_ERR_IO_ERROR;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct ndm_telnet_session_t *s =
+			(struct ndm_telnet_session_t *) events[i].data.ptr;
+
+		if (!s->removed) {
+			__ndm_telnet_session_process(s);
+		}
+	}
+
+	return NDM_TELNET_ERR_OK;
+#else /* NDM_TELNET_HAS_EPOLL */
+	return __ndm_telnet_poll_wait(reactor, timeout);
+#endif /* NDM_TELNET_HAS_EPOLL */
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_uring_wait(struct ndm_telnet_reactor_t *reactor,
+						const int timeout)
+{
+	uint64_t user_data = 0;
+	int32_t res = 0;
+
+	/* one system call submits all queued operations and waits */
+	if (!ndm_uring_wait(&reactor->uring, timeout)) {
+		return NDM_TELNET_ERR_IO_ERROR;
+	}
+
+	while (ndm_uring_peek(&reactor->uring, &user_data, &res)) {
+		__ndm_telnet_uring_complete(user_data, res);
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static void
+__ndm_telnet_reactor_backend_init(struct ndm_telnet_reactor_t *reactor,
+								  const enum ndm_telnet_reactor_backend_t backend)
+{
+	reactor->backend = backend;
+	reactor->epfd = -1;
+	reactor->pfds = NULL;
+	reactor->pfd_sessions = NULL;
+	reactor->pfds_cap = 0;
+	memset(&reactor->uring, 0, sizeof(reactor->uring));
+	reactor->uring.fd = -1;
+
+	/* fall back to a next available backend */
+	if (reactor->backend == NDM_TELNET_REACTOR_URING &&
+		!ndm_uring_init(&reactor->uring, NDM_TELNET_REACTOR_URING_ENTRIES)) {
+		reactor->backend = NDM_TELNET_REACTOR_EPOLL;
+	}
+
+	if (reactor->backend == NDM_TELNET_REACTOR_AUTO) {
+		reactor->backend = NDM_TELNET_REACTOR_EPOLL;
+	}
+
+	if (reactor->backend == NDM_TELNET_REACTOR_EPOLL) {
+#ifdef NDM_TELNET_HAS_EPOLL
+		reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+#endif /* NDM_TELNET_HAS_EPOLL */
+
+		if (reactor->epfd < 0) {
+			reactor->backend = NDM_TELNET_REACTOR_POLL;
+		}
+	}
+}
+
+static void
+__ndm_telnet_reactor_backend_free(struct ndm_telnet_reactor_t *reactor)
+{
+	if (reactor->epfd >= 0) {
+		close(reactor->epfd);
+	}
+
+	ndm_uring_free(&reactor->uring);
+	free(reactor->pfds);
+	free(reactor->pfd_sessions);
+}
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_open(struct ndm_telnet_reactor_t **reactor)
+{
+	return ndm_telnet_reactor_open_ex(reactor, NDM_TELNET_REACTOR_AUTO);
+}
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_open_ex(struct ndm_telnet_reactor_t **reactor,
+						   const enum ndm_telnet_reactor_backend_t backend)
+{
+	struct ndm_telnet_reactor_t *r =
+		(struct ndm_telnet_reactor_t *) malloc(sizeof(*r));
+
+	*reactor = NULL;
+
+	if (r == NULL) {
+		return NDM_TELNET_ERR_OOM;
+	}
+
+	r->sessions.head = NULL;
+	r->sessions.tail = NULL;
+	r->count = 0;
+	r->running = false;
+	r->has_removed = false;
+
+	__ndm_telnet_reactor_backend_init(r, backend);
+	*reactor = r;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+void ndm_telnet_reactor_close(struct ndm_telnet_reactor_t **reactor)
+{
+	struct ndm_telnet_reactor_t *r;
+	struct ndm_telnet_session_t *s;
+	size_t ops = 0;
+	int i;
+
+	if (reactor == NULL || *reactor == NULL) {
+		return;
+	}
+
+	r = *reactor;
+
+	for (s = r->sessions.head; s != NULL; s = s->next) {
+		if (s->ops > 0) {
+			/* pending receives and sends complete at once */
+			shutdown(ndm_telnet_fd(s->telnet), SHUT_RDWR);
+			__ndm_telnet_uring_cancel(s);
+			ops += s->ops;
+		}
+
+		s->removed = true;
+	}
+
+	/* session buffers are released after the kernel stops using them */
+	for (i = 0; ops > 0 && i < NDM_TELNET_REACTOR_URING_DRAIN; i++) {
+		uint64_t user_data = 0;
+		int32_t res = 0;
+
+		if (!ndm_uring_wait(&r->uring, 10)) {
+			break;
+		}
+
+		while (ndm_uring_peek(&r->uring, &user_data, &res)) {
+			if (user_data != 0) {
+				__ndm_telnet_uring_complete(user_data, res);
+				ops--;
+			}
+		}
+	}
+
+	while (r->sessions.head != NULL) {
+		s = r->sessions.head;
+		list_remove(r->sessions, s);
+
+		/* the kernel may still write into a receive buffer
+		 * of an undrained session, so only it is leaked */
+		if (s->recv_armed) {
+			ndm_telnet_recv_detach(s->telnet);
+		}
+
+		__ndm_telnet_session_free(s);
+	}
+
+	__ndm_telnet_reactor_backend_free(r);
+	free(r);
+	*reactor = NULL;
+}
+
+enum ndm_telnet_reactor_backend_t
+ndm_telnet_reactor_backend(const struct ndm_telnet_reactor_t *reactor)
+{
+	return reactor->backend;
+}
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_add(struct ndm_telnet_reactor_t *reactor,
+					   const struct sockaddr_in *const sin,
+					   const char *const login,
+					   const char *const password,
+					   const unsigned int timeout,
+					   const struct ndm_telnet_opts_t *opts,
+					   const struct ndm_telnet_handler_t *handler,
+					   void *data,
+					   struct ndm_telnet_session_t **session)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	struct ndm_telnet_opts_t o;
+	struct ndm_telnet_session_t *s = NULL;
+
+	*session = NULL;
+
+	if (opts == NULL) {
+		ndm_telnet_opts_init(&o);
+	} else {
+		o = *opts;
+	}
+
+	o.flags |= NDM_TELNET_FLAG_NON_BLOCKING;
+
+	if (reactor->backend == NDM_TELNET_REACTOR_URING) {
+		o.flags |= NDM_TELNET_FLAG_EXTERNAL_IO;
+	}
+
+	s = (struct ndm_telnet_session_t *) malloc(sizeof(*s));
+
+	if (s == NULL) {
+		return NDM_TELNET_ERR_OOM;
+	}
+
+	memset(s, 0, sizeof(*s));
+	s->reactor = reactor;
+	s->data = data;
+	s->timeout = timeout;
+	ndm_str_init(&s->tx, NDM_TELNET_TX_STP);
+
+	if (handler != NULL) {
+		s->handler = *handler;
+	}
+
+	err = ndm_telnet_open_ex(&s->telnet, sin, login, password, timeout, &o);
+
+	if (err != NDM_TELNET_ERR_AGAIN) {
+		ndm_telnet_close(&s->telnet);
+		free(s);
+
+		return (err == NDM_TELNET_ERR_OK) ?
+			NDM_TELNET_ERR_INTERNAL_ERROR : err;
+	}
+
+	list_append(reactor->sessions, s);
+	reactor->count++;
+	err = __ndm_telnet_session_watch(s);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		ndm_telnet_reactor_remove(s);
+
+		return err;
+	}
+
+	*session = s;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+void ndm_telnet_reactor_remove(struct ndm_telnet_session_t *session)
+{
+	struct ndm_telnet_reactor_t *reactor = session->reactor;
+
+	if (session->removed) {
+		return;
+	}
+
+	session->removed = true;
+	reactor->count--;
+
+	if (session->ops > 0) {
+		__ndm_telnet_uring_cancel(session);
+	}
+
+	if (reactor->running || session->ops > 0) {
+		/* the session may still be referenced by the dispatch loop
+		 * or by the kernel */
+		reactor->has_removed = true;
+		return;
+	}
+
+	list_remove(reactor->sessions, session);
+	__ndm_telnet_session_free(session);
+}
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_send(struct ndm_telnet_session_t *session,
+						const char *const command)
+{
+	const size_t len = strlen(command);
+	struct ndm_telnet_cmd_t *c = NULL;
+	enum ndm_telnet_err_t err = ndm_telnet_check_command(command);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+	if (session->removed) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
+
+	c = (struct ndm_telnet_cmd_t *)
+		malloc(offsetof(struct ndm_telnet_cmd_t, text) + len + 1);
+
+	if (c == NULL) {
+		return NDM_TELNET_ERR_OOM;
+	}
+
+	memcpy(c->text, command, len + 1);
+	list_append(session->queued, c);
+
+	err = __ndm_telnet_session_pump(session);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+	return __ndm_telnet_session_watch(session);
+}
+
+enum ndm_telnet_err_t
+ndm_telnet_reactor_run(struct ndm_telnet_reactor_t *reactor,
+					   const unsigned int timeout)
+{
+	const int64_t now = ndm_telnet_now();
+	int64_t wait = timeout;
+	struct ndm_telnet_session_t *s;
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	reactor->running = true;
+
+	/* expire silent sessions and find the nearest deadline */
+	for (s = reactor->sessions.head; s != NULL; s = s->next) {
+		int64_t deadline;
+
+		if (s->removed) {
+			continue;
+		}
+
+		deadline = ndm_telnet_deadline(s->telnet);
+
+		if (deadline < 0) {
+			continue;
+		}
+
+		if (deadline <= now) {
+			/* return to a caller without waiting */
+			__ndm_telnet_session_fail(s, NDM_TELNET_ERR_IO_TIMEOUT);
+			wait = 0;
+			continue;
+		}
+
+		if (deadline - now < wait) {
+			wait = deadline - now;
+		}
+	}
+
+	__ndm_telnet_reactor_sweep(reactor);
+
+	switch (reactor->backend) {
+		case NDM_TELNET_REACTOR_URING: {
+			err = __ndm_telnet_uring_wait(reactor, (int) wait);
+			break;
+		}
+
+		case NDM_TELNET_REACTOR_EPOLL: {
+			err = __ndm_telnet_epoll_wait(reactor, (int) wait);
+			break;
+		}
+
+		case NDM_TELNET_REACTOR_AUTO:
+		case NDM_TELNET_REACTOR_POLL:
+		default: {
+			err = __ndm_telnet_poll_wait(reactor, (int) wait);
+			break;
+		}
+	}
+
+	reactor->running = false;
+	__ndm_telnet_reactor_sweep(reactor);
+
+	return err;
+}
+
+size_t ndm_telnet_reactor_count(const struct ndm_telnet_reactor_t *reactor)
+{
+	return reactor->count;
+}
+
+struct ndm_telnet_t *
+ndm_telnet_session_telnet(const struct ndm_telnet_session_t *session)
+{
+	return session->telnet;
+}
@@ -0,0 +1,321 @@
+#include <stdint.h>
+#include <string.h>
+#include <libtelnet/libtelnet.h>
+#include <ylib/yxml_run.h>
+#include <ndmtelnet/scan.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+	(defined(__i386__) && defined(__SSE2__)) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NDM_SCAN_HAS_SSE2
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+#define NDM_SCAN_HAS_AVX2
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif /* SSE2 */
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define NDM_SCAN_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+typedef const char *(*ndm_scan_fn_t)(const char *p,
+									 const char *end,
+									 const struct ndm_scan_set_t *set);
+
+static const char *__ndm_scan_scalar(const char *p,
+									 const char *end,
+									 const struct ndm_scan_set_t *set)
+{
+	const unsigned int n = set->n;
+
+	while (p < end) {
+		const unsigned char ch = (unsigned char) *p;
+		unsigned int i;
+
+		for (i = 0; i < n; i++) {
+			if (ch == set->c[i]) {
+				return p;
+			}
+		}
+
+		p++;
+	}
+
+	return end;
+}
+
+#if defined(NDM_SCAN_HAS_SSE2) || defined(NDM_SCAN_HAS_NEON)
+
+static inline unsigned int __ndm_scan_ctz(const uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long i;
+
+#if defined(_M_X64)
+	_BitScanForward64(&i, mask);
+#else
+	if (!_BitScanForward(&i, (unsigned long) mask)) {
+		_BitScanForward(&i, (unsigned long) (mask >> 32));
+		i += 32;
+	}
+#endif
+
+	return (unsigned int) i;
+#else
+	return (unsigned int) __builtin_ctzll(mask);
+#endif
+}
+
+#endif /* NDM_SCAN_HAS_SSE2 || NDM_SCAN_HAS_NEON */
+
+#ifdef NDM_SCAN_HAS_SSE2
+
+static const char *__ndm_scan_sse2(const char *p,
+								   const char *end,
+								   const struct ndm_scan_set_t *set)
+{
+	const unsigned int n = set->n;
+	__m128i c[NDM_SCAN_SET_MAX];
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		c[i] = _mm_set1_epi8((char) set->c[i]);
+	}
+
+	while (end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) p);
+		__m128i m = _mm_setzero_si128();
+		unsigned int mask;
+
+		for (i = 0; i < n; i++) {
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, c[i]));
+		}
+
+		mask = (unsigned int) _mm_movemask_epi8(m);
+
+		if (mask != 0) {
+			return p + __ndm_scan_ctz(mask);
+		}
+
+		p += 16;
+	}
+
+	return __ndm_scan_scalar(p, end, set);
+}
+
+#endif /* NDM_SCAN_HAS_SSE2 */
+
+#ifdef NDM_SCAN_HAS_AVX2
+
+__attribute__((target("avx2")))
+static const char *__ndm_scan_avx2(const char *p,
+								   const char *end,
+								   const struct ndm_scan_set_t *set)
+{
+	const unsigned int n = set->n;
+	__m256i c[NDM_SCAN_SET_MAX];
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		c[i] = _mm256_set1_epi8((char) set->c[i]);
+	}
+
+	while (end - p >= 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *) p);
+		__m256i m = _mm256_setzero_si256();
+		unsigned int mask;
+
+		for (i = 0; i < n; i++) {
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, c[i]));
+		}
+
+		mask = (unsigned int) _mm256_movemask_epi8(m);
+
+		if (mask != 0) {
+			return p + __ndm_scan_ctz(mask);
+		}
+
+		p += 32;
+	}
+
+	return __ndm_scan_sse2(p, end, set);
+}
+
+#endif /* NDM_SCAN_HAS_AVX2 */
+
+#ifdef NDM_SCAN_HAS_NEON
+
+static const char *__ndm_scan_neon(const char *p,
+								   const char *end,
+								   const struct ndm_scan_set_t *set)
+{
+	const unsigned int n = set->n;
+	uint8x16_t c[NDM_SCAN_SET_MAX];
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		c[i] = vdupq_n_u8(set->c[i]);
+	}
+
+	while (end - p >= 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *) p);
+		uint8x16_t m = vdupq_n_u8(0);
+		uint64_t mask;
+
+		for (i = 0; i < n; i++) {
+			m = vorrq_u8(m, vceqq_u8(v, c[i]));
+		}
+
+		/* narrow a byte mask to four bits per byte */
+		mask = vget_lane_u64(vreinterpret_u64_u8(
+			vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+		if (mask != 0) {
+			return p + (__ndm_scan_ctz(mask) >> 2);
+		}
+
+		p += 16;
+	}
+
+	return __ndm_scan_scalar(p, end, set);
+}
+
+#endif /* NDM_SCAN_HAS_NEON */
+
+struct ndm_scan_kernel_t {
+	ndm_scan_fn_t fn;
+	const char *name;
+};
+
+static const char *__ndm_scan_select(const char *p,
+									 const char *end,
+									 const struct ndm_scan_set_t *set);
+
+static const struct ndm_scan_kernel_t NDM_SCAN_SELECT = {
+	__ndm_scan_select, "scalar"
+};
+
+static const struct ndm_scan_kernel_t NDM_SCAN_SCALAR = {
+	__ndm_scan_scalar, "scalar"
+};
+
+#ifdef NDM_SCAN_HAS_SSE2
+static const struct ndm_scan_kernel_t NDM_SCAN_SSE2 = {
+	__ndm_scan_sse2, "sse2"
+};
+#endif
+
+#ifdef NDM_SCAN_HAS_AVX2
+static const struct ndm_scan_kernel_t NDM_SCAN_AVX2 = {
+	__ndm_scan_avx2, "avx2"
+};
+#endif
+
+#ifdef NDM_SCAN_HAS_NEON
+static const struct ndm_scan_kernel_t NDM_SCAN_NEON = {
+	__ndm_scan_neon, "neon"
+};
+#endif
+
+/* a selected kernel is published once by any of concurrent first calls */
+static const struct ndm_scan_kernel_t *__ndm_scan_kernel = &NDM_SCAN_SELECT;
+
+static inline const struct ndm_scan_kernel_t *__ndm_scan_kernel_get(void)
+{
+#if defined(__GNUC__)
+	return __atomic_load_n(&__ndm_scan_kernel, __ATOMIC_ACQUIRE);
+#else
+	/* volatile accesses of MSVC have acquire and release semantics */
+	return *(const struct ndm_scan_kernel_t *const volatile *)
+		&__ndm_scan_kernel;
+#endif
+}
+
+static inline void
+__ndm_scan_kernel_set(const struct ndm_scan_kernel_t *kernel)
+{
+#if defined(__GNUC__)
+	__atomic_store_n(&__ndm_scan_kernel, kernel, __ATOMIC_RELEASE);
+#else
+	*(const struct ndm_scan_kernel_t *volatile *) &__ndm_scan_kernel = kernel;
+#endif
+}
+
+static const char *__ndm_scan_select(const char *p,
+									 const char *end,
+									 const struct ndm_scan_set_t *set)
+{
+	const struct ndm_scan_kernel_t *kernel = &NDM_SCAN_SCALAR;
+
+#if defined(NDM_SCAN_HAS_NEON)
+	kernel = &NDM_SCAN_NEON;
+#elif defined(NDM_SCAN_HAS_SSE2)
+	kernel = &NDM_SCAN_SSE2;
+
+#ifdef NDM_SCAN_HAS_AVX2
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		kernel = &NDM_SCAN_AVX2;
+	}
+#endif
+#endif
+
+	__ndm_scan_kernel_set(kernel);
+
+	return kernel->fn(p, end, set);
+}
+
+const char *ndm_scan(const char *p,
+					 const char *end,
+					 const struct ndm_scan_set_t *set)
+{
+	return __ndm_scan_kernel_get()->fn(p, end, set);
+}
+
+const char *ndm_scan_kernel(void)
+{
+	if (__ndm_scan_kernel_get() == &NDM_SCAN_SELECT) {
+		static const struct ndm_scan_set_t set = {{0}, 0};
+		const char *p = "";
+
+		__ndm_scan_select(p, p, &set);
+	}
+
+	return __ndm_scan_kernel_get()->name;
+}
+
+/* hooks of vendored decoders, see TELNET_SCAN_HOOK and YXML_SCAN_HOOK */
+static inline const char *__ndm_scan_hook(const char *p,
+										  const char *end,
+										  const unsigned char *bytes,
+										  const size_t n)
+{
+	struct ndm_scan_set_t set;
+
+	memcpy(set.c, bytes, n);
+	set.n = (unsigned int) n;
+
+	return ndm_scan(p, end, &set);
+}
+
+const char *telnet_scan_hook(const char *p,
+							 const char *end,
+							 const unsigned char *set,
+							 size_t n)
+{
+	return __ndm_scan_hook(p, end, set, n);
+}
+
+const char *yxml_scan_hook(const char *p,
+						   const char *end,
+						   const unsigned char *set,
+						   size_t n)
+{
+	return __ndm_scan_hook(p, end, set, n);
+}
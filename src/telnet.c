@@ -10,19 +10,113 @@
 #include <sys/types.h>
 #include <libtelnet/libtelnet.h>
 #include <ndmtelnet/xml.h>
+#include <ndmtelnet/query.h>
 #include <ndmtelnet/str.h>
+#include <ndmtelnet/buf.h>
 #include <ndmtelnet/code.h>
 #include <ndmtelnet/telnet.h>
 
+enum ndm_telnet_state_t {
+	NDM_TELNET_STATE_CONNECT,
+	NDM_TELNET_STATE_LOGIN,
+	NDM_TELNET_STATE_RAW,
+	NDM_TELNET_STATE_RAW_RESPONSE,
+	NDM_TELNET_STATE_READY
+};
+
+enum ndm_telnet_prompt_t
+{
+	NDM_TELNET_PROMPT_LOGIN,
+	NDM_TELNET_PROMPT_PASSWORD,
+	NDM_TELNET_PROMPT_CONFIG,
+	NDM_TELNET_PROMPT_RAW,
+	NDM_TELNET_PROMPT_NONE
+};
+
+enum ndm_telnet_status_elem_t
+{
+	NDM_TELNET_STATUS_MESSAGE,
+	NDM_TELNET_STATUS_ERROR,
+	NDM_TELNET_STATUS_NONE
+};
+
+/* the first coded <message> or <error> of a response, or the last one */
+struct ndm_telnet_status_msg_t
+{
+	bool seen;
+	bool found;					/* a nonzero code found */
+	bool bad;					/* a wrong format */
+	ndm_code_t code;
+	struct ndm_str_t text;
+	const char *value;			/* a document text instead of a copy */
+};
+
+/* a response status collected while a response is streamed */
+struct ndm_telnet_status_t
+{
+	const struct ndm_xml_sax_t *sax;
+	void *data;
+	bool event;
+	bool bad;
+	bool oom;
+	bool prompt;
+	bool continued;
+	enum ndm_telnet_status_elem_t elem;	/* an open root child */
+	uint32_t group;
+	uint32_t local;
+	bool code_seen;
+	bool flag;					/* "warning" or "critical" is "yes" */
+	bool flag_seen;
+	bool elem_bad;
+	struct ndm_str_t text;
+	struct ndm_telnet_status_msg_t msgs[NDM_TELNET_STATUS_NONE];
+};
+
+/* root children a filtered response status is found in */
+static const char *const NDM_TELNET_STATUS_PATHS[] = {
+	"message", "error", "prompt", "continued"
+};
+
+#define NDM_TELNET_STATUS_QUERIES										\
+	(sizeof(NDM_TELNET_STATUS_PATHS) / sizeof(NDM_TELNET_STATUS_PATHS[0]))
+
 struct ndm_telnet_t {
 	int sock;
 	int64_t io_deadline;
+	int64_t io_now;
+	unsigned int io_timeout;
 	telnet_t *stream;
 	enum ndm_telnet_err_t stream_err;
-	char *buf_r;
-	char *buf_w;
-	char *buf_e;
-	char buf[1];
+	struct ndm_str_t out;
+	struct ndm_telnet_stats_t stats;
+	struct ndm_buf_t in;
+	size_t in_size;
+	size_t in_max_size;
+	bool in_full;
+	char *in_lock;
+	size_t in_lock_size;
+	bool non_blocking;
+	bool external_io;
+	bool optimistic_io;
+	bool fast_open;
+	bool typed_ahead;
+	enum ndm_telnet_state_t state;
+	size_t pending;
+	enum ndm_telnet_prompt_t prompt;
+	size_t prompt_pos;
+	bool prompt_skip;
+	size_t esc_pos;
+	struct ndm_str_t user;
+	struct ndm_str_t password;
+	bool user_sent;
+	bool password_sent;
+	bool raw_sent;
+	struct ndm_xml_dom_t dom;
+	struct ndm_xml_arena_t *arena;
+	struct ndm_telnet_status_t status;
+	size_t cursor_skip;			/* a skipped status element depth + 1 */
+	struct ndm_xml_filter_t filter;
+	struct ndm_xml_query_t *status_queries[NDM_TELNET_STATUS_QUERIES];
 };
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -124,12 +218,15 @@ __ndm_telnet_set_non_blocking(struct ndm_telnet_t *telnet)
 #endif
 
 #define NDM_TELNET_RAW_MODE						"!raw"
-#define NDM_TELNET_BUFFER_SIZE					4096
 #define NDM_TELNET_STR_STP						64
+#define NDM_TELNET_OUT_STP						256
 #define NDM_TELNET_ESC							"\033[K"
 #define NDM_TELNET_ESC_LEN						(sizeof(NDM_TELNET_ESC) - 1)
 #define NDM_TELNET_LOGIN						"Login: "
+#define NDM_TELNET_LOGIN_LEN					(sizeof(NDM_TELNET_LOGIN) - 1)
 #define NDM_TELNET_PASSWORD						"Password: "
+#define NDM_TELNET_PASSWORD_LEN					\
+	(sizeof(NDM_TELNET_PASSWORD) - 1)
 #define NDM_TELNET_CONFIG						"(config)> "
 #define NDM_TELNET_CONFIG_LEN					\
 	(sizeof(NDM_TELNET_CONFIG) - 1)
@@ -146,11 +243,29 @@ __ndm_telnet_interrupted(const int io_error)
 		io_error == IO_ERROR_EWOULDBLOCK;
 }
 
-static ssize_t __ndm_telnet_poll(const struct ndm_telnet_t *telnet,
+static inline bool
+__ndm_telnet_would_block(const int io_error)
+{
+	return
+		io_error == IO_ERROR_EAGAIN ||
+		io_error == IO_ERROR_EWOULDBLOCK;
+}
+
+static inline int64_t __ndm_telnet_clock(struct ndm_telnet_t *telnet)
+{
+	/* a clock is read once per API call or I/O wakeup */
+	if (telnet->io_now < 0) {
+		telnet->io_now = ndm_telnet_now();
+	}
+
+	return telnet->io_now;
+}
+
+static ssize_t __ndm_telnet_poll(struct ndm_telnet_t *telnet,
 								 const short events)
 {
 	struct pollfd pfd;
-	const int64_t now = ndm_telnet_now();
+	int64_t now = 0;
 	int timeout = 0;
 	ssize_t n;
 
@@ -158,11 +273,23 @@ static ssize_t __ndm_telnet_poll(const struct ndm_telnet_t *telnet,
 	pfd.events = events;
 	pfd.revents = 0;
 
-	if (telnet->io_deadline > now) {
-		timeout = (int) (telnet->io_deadline - now);
+	/* a non-blocking session only checks readiness */
+	if (!telnet->non_blocking) {
+		now = __ndm_telnet_clock(telnet);
+
+		if (telnet->io_deadline > now) {
+			timeout = (int) (telnet->io_deadline - now);
+		}
 	}
 
 	n = (ssize_t) poll(&pfd, 1, timeout);
+	telnet->stats.polls++;
+	telnet->stats.syscalls++;
+
+	if (timeout > 0) {
+		/* the time has passed while waiting */
+		telnet->io_now = -1;
+	}
 
 	if (n > 0 && (pfd.revents & (POLLNVAL | POLLERR))) {
 		if (pfd.revents & POLLNVAL) {
@@ -179,34 +306,64 @@ static ssize_t __ndm_telnet_poll(const struct ndm_telnet_t *telnet,
 
 static enum ndm_telnet_err_t __ndm_telnet_send(struct ndm_telnet_t *telnet,
 											   const void *const data,
-											   const size_t data_size)
+											   const size_t data_size,
+											   size_t *sent)
 {
 	const char *p = (const char *) data;
 	const char *pend = p + data_size;
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	bool wait = !telnet->non_blocking && !telnet->optimistic_io;
 
 	while (p < pend) {
-		ssize_t n = __ndm_telnet_poll(telnet, POLLWRNORM);
+		ssize_t n = 1;
+
+		if (wait) {
+			n = __ndm_telnet_poll(telnet, POLLWRNORM);
+		}
 
 		if (n > 0) {
 			n = send(telnet->sock, p, (size_t) (pend - p), 0);
+			telnet->stats.syscalls++;
+
+			if (n > 0) {
+				telnet->stats.sends++;
+				telnet->stats.bytes_sent += (uint64_t) n;
+			}
 		}
 
 		if (n < 0) { /* poll or send failed */
-			if (__ndm_telnet_interrupted(io_error_get())) {
+			const int io_error = io_error_get();
+
+			if (__ndm_telnet_would_block(io_error)) {
+				if (telnet->non_blocking) {
+					err = NDM_TELNET_ERR_AGAIN;
+					break;
+				}
+
+				/* a socket buffer is full, wait for a free space */
+				wait = true;
+				continue;
+			}
+
+			if (__ndm_telnet_interrupted(io_error)) {
 				continue;
 			}
 
-			return NDM_TELNET_ERR_SEND;
+			err = NDM_TELNET_ERR_SEND;
+			break;
 		}
 
 		if (n == 0) {
-			return NDM_TELNET_ERR_IO_TIMEOUT;
+			err = NDM_TELNET_ERR_IO_TIMEOUT;
+			break;
 		}
 
 		p += (size_t) n;
 	}
 
-	return NDM_TELNET_ERR_OK;
+	*sent = (size_t) (p - (const char *) data);
+
+	return err;
 }
 
 static void __ndm_telnet_event(telnet_t *telnet,
@@ -216,33 +373,32 @@ static void __ndm_telnet_event(telnet_t *telnet,
 	struct ndm_telnet_t *client = (struct ndm_telnet_t *) ud;
 
 	if (ev->type == TELNET_EV_DATA) {
-		const size_t avail = (size_t) (client->buf_e - client->buf_w);
+		char *w = client->in.w;
 
-		if (ev->data.size > avail) {
-			const size_t shift = (size_t) (client->buf_r - client->buf);
-
-			if (ev->data.size > avail + shift) {
-				/* buffer overflow, should never occur really */
-				client->stream_err = NDM_TELNET_ERR_BUFFER_OVERFLOW;
-				return;
-			}
+		if (ev->data.size > ndm_buf_space(&client->in)) {
+			/* buffer overflow, should never occur really */
+			client->stream_err = NDM_TELNET_ERR_BUFFER_OVERFLOW;
+			return;
+		}
 
-			memmove(client->buf, client->buf_r,
-					(size_t) (client->buf_w - client->buf_r));
-			client->buf_r -= shift;
-			client->buf_w -= shift;
+		/* data was received in place, so a plain chunk is already
+		 * at the write position, and a chunk following stripped
+		 * telnet commands should be moved back to it */
+		if (ev->data.buffer != w) {
+			memmove(w, ev->data.buffer, ev->data.size);
 		}
 
-		memcpy(client->buf_w, ev->data.buffer, ev->data.size);
-		client->buf_w += ev->data.size;
+		ndm_buf_commit(&client->in, ev->data.size);
 
 		return;
 	}
 
 	if (ev->type == TELNET_EV_SEND) {
-		client->stream_err = __ndm_telnet_send(client,
-											   ev->data.buffer,
-											   ev->data.size);
+		/* gather all fragments to send them at once */
+		if (!ndm_str_append(&client->out, ev->data.buffer, ev->data.size)) {
+			client->stream_err = NDM_TELNET_ERR_OOM;
+		}
+
 		return;
 	}
 
@@ -252,32 +408,119 @@ static void __ndm_telnet_event(telnet_t *telnet,
 	}
 }
 
+static enum ndm_telnet_err_t __ndm_telnet_flush(struct ndm_telnet_t *telnet)
+{
+	enum ndm_telnet_err_t err = telnet->stream_err;
+
+	if (err == NDM_TELNET_ERR_OK &&
+		ndm_str_len(&telnet->out) > 0 &&
+		!telnet->external_io) {
+		size_t sent = 0;
+
+		err = __ndm_telnet_send(telnet,
+								ndm_str_ptr(&telnet->out),
+								ndm_str_len(&telnet->out), &sent);
+
+		if (sent == ndm_str_len(&telnet->out)) {
+			ndm_str_clear(&telnet->out);
+		} else {
+			ndm_str_erase(&telnet->out, 0, sent);
+		}
+
+		if (err == NDM_TELNET_ERR_AGAIN) {
+			/* the rest is sent when a socket becomes writable */
+			err = NDM_TELNET_ERR_OK;
+		}
+	}
+
+	return err;
+}
+
+static enum ndm_telnet_err_t __ndm_telnet_reserve(struct ndm_telnet_t *telnet,
+												  size_t *reserved)
+{
+	size_t size = ndm_buf_reserve(&telnet->in);
+
+	/* grow a buffer geometrically while a peer sends more than fits */
+	if ((size == 0 || telnet->in_full) &&
+		telnet->in.cap < telnet->in_max_size) {
+		size_t cap = 2 * telnet->in.cap;
+
+		if (cap > telnet->in_max_size) {
+			cap = telnet->in_max_size;
+		}
+
+		if (!ndm_buf_resize(&telnet->in, cap)) {
+			return NDM_TELNET_ERR_OOM;
+		}
+
+		size = ndm_buf_reserve(&telnet->in);
+	}
+
+	if (size == 0) {
+		return NDM_TELNET_ERR_BUFFER_OVERFLOW;
+	}
+
+	*reserved = size;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t __ndm_telnet_received(struct ndm_telnet_t *telnet,
+												   char *in,
+												   const size_t size,
+												   const size_t n)
+{
+	telnet->stats.recvs++;
+	telnet->stats.bytes_received += (uint64_t) n;
+	telnet->in_full = (n == size);
+
+	/* telnet commands are stripped in place */
+	telnet_recv(telnet->stream, in, n);
+
+	/* send negotiation replies if any */
+	return __ndm_telnet_flush(telnet);
+}
+
 static enum ndm_telnet_err_t __ndm_telnet_fill(struct ndm_telnet_t *telnet)
 {
 	ssize_t n;
-	size_t size;
-	char buf[NDM_TELNET_BUFFER_SIZE];
+	size_t size = 0;
+	char *in;
+	enum ndm_telnet_err_t err;
 
-	if (telnet->buf_w == telnet->buf_e) {
-		telnet->buf_r = telnet->buf;
-		telnet->buf_w = telnet->buf;
+	/* a peer likely sent more data if a previous chunk filled a buffer */
+	bool wait = !telnet->non_blocking &&
+		!(telnet->optimistic_io && telnet->in_full);
+
+	if (telnet->external_io) {
+		/* wait for ndm_telnet_recv_commit() */
+		return NDM_TELNET_ERR_AGAIN;
 	}
 
-	size = (size_t) (telnet->buf_e - telnet->buf_w);
+	err = __ndm_telnet_reserve(telnet, &size);
 
-	if (size > sizeof(buf)) {
-		size = sizeof(buf);
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
 	}
 
+	/* receive directly into the free buffer tail */
+	in = telnet->in.w;
+
 	do {
-		n = __ndm_telnet_poll(telnet, POLLRDNORM | POLLRDBAND);
+		n = 1;
 
-		if (n == 0) {
-			return NDM_TELNET_ERR_IO_TIMEOUT;
+		if (wait) {
+			n = __ndm_telnet_poll(telnet, POLLRDNORM | POLLRDBAND);
+
+			if (n == 0) {
+				return NDM_TELNET_ERR_IO_TIMEOUT;
+			}
 		}
 
 		if (n > 0) {
-			n = recv(telnet->sock, buf, size, 0);
+			n = recv(telnet->sock, in, size, 0);
+			telnet->stats.syscalls++;
 
 			if (n == 0) {
 				return NDM_TELNET_ERR_DISCONNECTED;
@@ -285,7 +528,19 @@ static enum ndm_telnet_err_t __ndm_telnet_fill(struct ndm_telnet_t *telnet)
 		}
 
 		if (n < 0) { /* poll or receive failed */
-			if (__ndm_telnet_interrupted(io_error_get())) {
+			const int io_error = io_error_get();
+
+			if (__ndm_telnet_would_block(io_error)) {
+				if (telnet->non_blocking) {
+					return NDM_TELNET_ERR_AGAIN;
+				}
+
+				/* no data is received yet, wait for it */
+				wait = true;
+				continue;
+			}
+
+			if (__ndm_telnet_interrupted(io_error)) {
 				continue;
 			}
 
@@ -293,14 +548,23 @@ static enum ndm_telnet_err_t __ndm_telnet_fill(struct ndm_telnet_t *telnet)
 		}
 	} while (n < 0);
 
-	telnet_recv(telnet->stream, buf, (size_t) n);
+	return __ndm_telnet_received(telnet, in, size, (size_t) n);
+}
 
-	return telnet->stream_err;
+static inline void __ndm_telnet_shrink(struct ndm_telnet_t *telnet)
+{
+	/* an idle session returns to its initial buffer size */
+	if (telnet->in_lock == NULL &&
+		ndm_buf_len(&telnet->in) == 0 &&
+		telnet->in.cap > telnet->in_size &&
+		ndm_buf_resize(&telnet->in, telnet->in_size)) {
+		telnet->in_full = false;
+	}
 }
 
 static enum ndm_telnet_err_t
-__ndm_telnet_send_cmd(struct ndm_telnet_t *telnet,
-					  const char *const cmd)
+__ndm_telnet_queue_cmd(struct ndm_telnet_t *telnet,
+					   const char *const cmd)
 {
 	static const char NEW_LINE = '\n';
 
@@ -311,10 +575,25 @@ __ndm_telnet_send_cmd(struct ndm_telnet_t *telnet,
 	}
 
 	telnet_send_text(telnet->stream, &NEW_LINE, sizeof(NEW_LINE));
+	telnet->stats.commands++;
+	telnet->pending++;
 
 	return telnet->stream_err;
 }
 
+static enum ndm_telnet_err_t
+__ndm_telnet_send_cmd(struct ndm_telnet_t *telnet,
+					  const char *const cmd)
+{
+	const enum ndm_telnet_err_t err = __ndm_telnet_queue_cmd(telnet, cmd);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+	return __ndm_telnet_flush(telnet);
+}
+
 static inline bool
 __ndm_telnet_get_ulong(const char *const arg,
 					   unsigned long *l)
@@ -335,646 +614,1806 @@ __ndm_telnet_get_ulong(const char *const arg,
 	return true;
 }
 
-static inline bool
-__ndm_telnet_get_code(struct ndm_xml_elem_t *elem,
-					  uint32_t *group,
-					  uint32_t *local)
+static inline void
+__ndm_telnet_response_done(struct ndm_telnet_t *telnet)
 {
-	unsigned long l = 0;
-	struct ndm_xml_attr_t *a_code = ndm_xml_elem_find_attr(elem, "code");
-
-	*group = 0;
-	*local = 0;
-
-	if (a_code == NULL) {
-		/* just <message> or <error> node without a code */
-		return true;
+	if (telnet->pending > 0) {
+		telnet->pending--;
 	}
 
-	if (!__ndm_telnet_get_ulong(a_code->value, &l) || l > UINT32_MAX) {
-		/* should be a 32-bit decimal unsigned integer */
-		return false;
+	if (telnet->non_blocking && telnet->pending > 0) {
+		/* a next pending command has a whole timeout */
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + telnet->io_timeout;
 	}
-
-	*group = NDM_CODEGROUP((uint32_t) l);
-	*local = NDM_CODELOCAL((uint32_t) l);
-
-	return true;
 }
 
 static enum ndm_telnet_err_t
-__ndm_telnet_recv(struct ndm_telnet_t *telnet,
-				  bool *continued,
-				  ndm_code_t *response_code,
-				  const char **response_text,
-				  struct ndm_xml_elem_t **response)
+__ndm_telnet_xml_err(const enum ndm_xml_err_t xml_err)
 {
-	struct ndm_xml_dom_t dom;
-	struct ndm_xml_elem_t *e;
-	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	switch (xml_err) {
+		case NDM_XML_ERR_OK: {
+			return NDM_TELNET_ERR_OK;
+		}
 
-	ndm_xml_dom_init(&dom);
+		case NDM_XML_ERR_NOMEM: {
+			return NDM_TELNET_ERR_OOM;
+		}
 
-	*continued = false;
-	*response_code = 0;
-	*response_text = NULL;
-	*response = NULL;
+		case NDM_XML_ERR_EOF: {
+			return NDM_TELNET_ERR_RESPONSE_EOS;
+		}
 
-	while (*response == NULL) {
-		enum ndm_xml_err_t xml_err = NDM_XML_ERR_OK;
-		size_t parsed_size = 0;
-		size_t avail;
+		case NDM_XML_ERR_REF:
+		case NDM_XML_ERR_CLOSE:
+		case NDM_XML_ERR_SYNTAX:
+		case NDM_XML_ERR_PI: {
+			return NDM_TELNET_ERR_RESPONSE_SYNTAX;
+		}
 
-		if (telnet->buf_r == telnet->buf_w) {
-			err = __ndm_telnet_fill(telnet);
+		case NDM_XML_ERR_STACK: {
+			return NDM_TELNET_ERR_BUFFER_OVERFLOW;
+		}
 
-			if (err != NDM_TELNET_ERR_OK) {
-				goto error;
-			}
+		case NDM_XML_ERR_INTERNAL:
+		case NDM_XML_ERR_QUERY: {
+			return NDM_TELNET_ERR_INTERNAL_ERROR;
 		}
 
-		avail = (size_t) (telnet->buf_w - telnet->buf_r);
-		xml_err = ndm_xml_dom_parse(telnet->buf_r, avail,
-									&dom, &parsed_size, response);
+		default: {
+			return NDM_TELNET_ERR_UNKNOWN_ERROR;
+		}
+	}
+}
 
-		switch (xml_err) {
-			case NDM_XML_ERR_OK: {
-				telnet->buf_r += parsed_size;
-				break;
-			}
+static void __ndm_telnet_status_reset(struct ndm_telnet_status_t *st)
+{
+	size_t i;
+
+	st->event = false;
+	st->bad = false;
+	st->oom = false;
+	st->prompt = false;
+	st->continued = false;
+	st->elem = NDM_TELNET_STATUS_NONE;
+
+	for (i = 0; i < NDM_TELNET_STATUS_NONE; i++) {
+		st->msgs[i].seen = false;
+		st->msgs[i].found = false;
+		st->msgs[i].bad = false;
+		st->msgs[i].code = 0;
+		ndm_str_clear(&st->msgs[i].text);
+		st->msgs[i].value = NULL;
+	}
+}
 
-			case NDM_XML_ERR_NOMEM: {
-				err = NDM_TELNET_ERR_OOM;
-				goto error;
-			}
+static void __ndm_telnet_status_init(struct ndm_telnet_status_t *st)
+{
+	size_t i;
 
-			case NDM_XML_ERR_EOF: {
-				err = NDM_TELNET_ERR_RESPONSE_EOS;
-				goto error;
-			}
+	st->sax = NULL;
+	st->data = NULL;
+	ndm_str_init(&st->text, NDM_TELNET_STR_STP);
 
-			case NDM_XML_ERR_REF:
-			case NDM_XML_ERR_CLOSE:
-			case NDM_XML_ERR_SYNTAX:
-			case NDM_XML_ERR_PI: {
-				err = NDM_TELNET_ERR_RESPONSE_SYNTAX;
-				goto error;
-			}
+	for (i = 0; i < NDM_TELNET_STATUS_NONE; i++) {
+		ndm_str_init(&st->msgs[i].text, NDM_TELNET_STR_STP);
+	}
 
-			case NDM_XML_ERR_STACK: {
-				err = NDM_TELNET_ERR_BUFFER_OVERFLOW;
-				goto error;
-			}
+	__ndm_telnet_status_reset(st);
+}
 
-			case NDM_XML_ERR_INTERNAL: {
-				err = NDM_TELNET_ERR_INTERNAL_ERROR;
-				goto error;
-			}
+static void __ndm_telnet_status_free(struct ndm_telnet_status_t *st)
+{
+	size_t i;
 
-			default: {
-				err = NDM_TELNET_ERR_UNKNOWN_ERROR;
-				goto error;
-			}
-		}
-	}
+	ndm_str_free(&st->text);
 
-	if (strcmp((*response)->name, "event") == 0) {
-		*response_text = "";
-		goto done;
+	for (i = 0; i < NDM_TELNET_STATUS_NONE; i++) {
+		ndm_str_free(&st->msgs[i].text);
 	}
+}
 
-	if (strcmp((*response)->name, "response") != 0) {
-		err = NDM_TELNET_ERR_RESPONSE_FORMAT;
-		goto error;
+static inline void
+__ndm_telnet_status_root(struct ndm_telnet_status_t *st,
+						 const char *const name)
+{
+	st->event = (strcmp(name, "event") == 0);
+	st->bad = !st->event && strcmp(name, "response") != 0;
+}
+
+/* a root child of a response starts */
+static void __ndm_telnet_status_child(struct ndm_telnet_status_t *st,
+									  const char *const name)
+{
+	if (strcmp(name, "message") == 0) {
+		st->elem = NDM_TELNET_STATUS_MESSAGE;
+	} else if (strcmp(name, "error") == 0) {
+		st->elem = NDM_TELNET_STATUS_ERROR;
+	} else if (strcmp(name, "prompt") == 0) {
+		st->prompt = true;
+	} else if (strcmp(name, "continued") == 0) {
+		st->continued = true;
 	}
 
-	e = ndm_xml_elem_find_child(*response, "message");
+	if (st->elem != NDM_TELNET_STATUS_NONE) {
+		st->group = 0;
+		st->local = 0;
+		st->code_seen = false;
+		st->flag = false;
+		st->flag_seen = false;
+		st->elem_bad = false;
+		ndm_str_clear(&st->text);
+	}
+}
 
-	while (e != NULL) {
-		uint32_t group = 0;
-		uint32_t local = 0;
-		struct ndm_xml_attr_t *a_warn = NULL;
+/* an attribute of an open <message> or <error> */
+static void __ndm_telnet_status_child_attr(struct ndm_telnet_status_t *st,
+										   const char *const name,
+										   const char *const value)
+{
+	const char *flag = (st->elem == NDM_TELNET_STATUS_MESSAGE) ?
+		"warning" : "critical";
 
-		if (!__ndm_telnet_get_code(e, &group, &local)) {
-			err = NDM_TELNET_ERR_RESPONSE_FORMAT;
-			goto error;
-		}
+	/* the first of duplicate attributes is used as in a document */
+	if (!st->code_seen && strcmp(name, "code") == 0) {
+		unsigned long l = 0;
 
-		a_warn = ndm_xml_elem_find_attr(e, "warning");
-		*response_code = NDM_CODE_I(group, local);
+		st->code_seen = true;
 
-		if (a_warn != NULL) {
-			if (strcmp(a_warn->value, "yes") == 0) {
-				*response_code = NDM_CODE_W(group, local);
-			} else if (strcmp(a_warn->value, "no") != 0) {
-				err = NDM_TELNET_ERR_RESPONSE_FORMAT;
-				goto error;
-			}
+		if (!__ndm_telnet_get_ulong(value, &l) || l > UINT32_MAX) {
+			/* should be a 32-bit decimal unsigned integer */
+			st->elem_bad = true;
+		} else {
+			st->group = NDM_CODEGROUP((uint32_t) l);
+			st->local = NDM_CODELOCAL((uint32_t) l);
 		}
+	} else if (!st->flag_seen && strcmp(name, flag) == 0) {
+		st->flag_seen = true;
 
-		*response_text = e->value;
-
-		if (*response_code != 0) {
-			break;
+		if (strcmp(value, "yes") == 0) {
+			st->flag = true;
+		} else if (strcmp(value, "no") != 0) {
+			st->elem_bad = true;
 		}
-
-		e = ndm_xml_elem_find_next(e, "message");
 	}
+}
 
-	if (*response_code == 0) {
-		e = ndm_xml_elem_find_child(*response, "error");
-
-		while (e != NULL) {
-			uint32_t group = 0;
-			uint32_t local = 0;
-			struct ndm_xml_attr_t *a_crit = NULL;
-
-			if (!__ndm_telnet_get_code(e, &group, &local)) {
-				err = NDM_TELNET_ERR_RESPONSE_FORMAT;
-				goto error;
-			}
-
-			a_crit = ndm_xml_elem_find_attr(e, "critical");
-			*response_code = NDM_CODE_E(group, local);
+/* an open <message> or <error> ends with a collected text,
+ * or with a document @a value if it is not null */
+static void __ndm_telnet_status_child_end(struct ndm_telnet_status_t *st,
+										  const char *const value)
+{
+	struct ndm_telnet_status_msg_t *m = &st->msgs[st->elem];
 
-			if (a_crit != NULL) {
-				if (strcmp(a_crit->value, "yes") == 0) {
-					*response_code = NDM_CODE_C(group, local);
-				} else if (strcmp(a_crit->value, "no") != 0) {
-					err = NDM_TELNET_ERR_RESPONSE_FORMAT;
-					goto error;
-				}
+	/* messages after a coded one are not checked */
+	if (!m->found) {
+		if (st->elem_bad) {
+			m->bad = true;
+			m->found = true;
+		} else {
+			if (st->elem == NDM_TELNET_STATUS_MESSAGE) {
+				m->code = st->flag ?
+					NDM_CODE_W(st->group, st->local) :
+					NDM_CODE_I(st->group, st->local);
+			} else {
+				m->code = st->flag ?
+					NDM_CODE_C(st->group, st->local) :
+					NDM_CODE_E(st->group, st->local);
 			}
 
-			*response_text = e->value;
+			if (value == NULL) {
+				const struct ndm_str_t text = m->text;
 
-			if (*response_code != 0) {
-				break;
+				m->text = st->text;
+				st->text = text;
 			}
 
-			e = ndm_xml_elem_find_next(e, "error");
+			m->value = value;
+			m->seen = true;
+			m->found = (m->code != 0);
 		}
 	}
 
-	if (*response_text == NULL) {
-		e = ndm_xml_elem_find_child(*response, "prompt");
+	st->elem = NDM_TELNET_STATUS_NONE;
+}
 
-		if (e != NULL) {
-			*response_text = "";
-		}
+static void __ndm_telnet_status_elem_start(const char *name,
+										   const size_t depth,
+										   void *data)
+{
+	struct ndm_telnet_status_t *st = &((struct ndm_telnet_t *) data)->status;
+
+	if (depth == 0) {
+		__ndm_telnet_status_reset(st);
+		__ndm_telnet_status_root(st, name);
+	} else if (depth == 1 && !st->event) {
+		__ndm_telnet_status_child(st, name);
 	}
 
-	e = ndm_xml_elem_find_child(*response, "continued");
+	if (st->sax != NULL && st->sax->elem_start != NULL) {
+		st->sax->elem_start(name, depth, st->data);
+	}
+}
 
-	if (e != NULL) {
-		*continued = true;
+static void __ndm_telnet_status_attr(const char *name,
+									 const char *value,
+									 const size_t value_len,
+									 const size_t depth,
+									 void *data)
+{
+	struct ndm_telnet_status_t *st = &((struct ndm_telnet_t *) data)->status;
 
-		if (*response_text == NULL) {
-			*response_text = "";
-		}
+	if (depth == 1 && st->elem != NDM_TELNET_STATUS_NONE) {
+		__ndm_telnet_status_child_attr(st, name, value);
 	}
 
-	if (*response_text == NULL) {
-		err = NDM_TELNET_ERR_RESPONSE_FORMAT;
-		goto error;
+	if (st->sax != NULL && st->sax->attr != NULL) {
+		st->sax->attr(name, value, value_len, depth, st->data);
 	}
+}
 
-done:
-	ndm_xml_dom_free(&dom);
-
-	return NDM_TELNET_ERR_OK;
-
-error:
-	ndm_xml_dom_free(&dom);
-	ndm_xml_doc_free(response);
+static void __ndm_telnet_status_content(const char *chunk,
+										const size_t size,
+										const size_t depth,
+										void *data)
+{
+	struct ndm_telnet_status_t *st = &((struct ndm_telnet_t *) data)->status;
 
-	*continued = false;
-	*response_code = 0;
-	*response_text = NULL;
-	*response = NULL;
+	if (depth == 1 && st->elem != NDM_TELNET_STATUS_NONE &&
+		!st->msgs[st->elem].found &&
+		!ndm_str_append(&st->text, chunk, size)) {
+		st->oom = true;
+	}
 
-	return err;
+	if (st->sax != NULL && st->sax->content != NULL) {
+		st->sax->content(chunk, size, depth, st->data);
+	}
 }
 
-static inline void
-__ndm_telnet_remove_esc(struct ndm_str_t *str)
+static void __ndm_telnet_status_elem_end(const char *name,
+										 const size_t depth,
+										 void *data)
 {
-	size_t l = ndm_str_len(str);
-	size_t i = 0;
-
-	while (i + NDM_TELNET_ESC_LEN <= l) {
-		const char *ptr = ndm_str_ptr(str);
-		size_t j = 0;
+	struct ndm_telnet_status_t *st = &((struct ndm_telnet_t *) data)->status;
 
-		for (; j < NDM_TELNET_ESC_LEN; j++) {
-			if (ptr[i + j] != NDM_TELNET_ESC[j]) {
-				break;
-			}
-		}
+	if (depth == 1 && st->elem != NDM_TELNET_STATUS_NONE) {
+		__ndm_telnet_status_child_end(st, NULL);
+	}
 
-		if (j == NDM_TELNET_ESC_LEN) {
-			ndm_str_erase(str, i, NDM_TELNET_ESC_LEN);
-			l -= NDM_TELNET_ESC_LEN;
-		} else {
-			i++;
-		}
+	if (st->sax != NULL && st->sax->elem_end != NULL) {
+		st->sax->elem_end(name, depth, st->data);
 	}
 }
 
-static inline bool
-__ndm_telnet_has_lf(const char *const str)
+static const struct ndm_xml_sax_t NDM_TELNET_STATUS_SAX = {
+	__ndm_telnet_status_elem_start,
+	__ndm_telnet_status_attr,
+	__ndm_telnet_status_content,
+	__ndm_telnet_status_elem_end
+};
+
+/* a status of a built document is found as its root children end */
+static void __ndm_telnet_status_elem(const struct ndm_xml_elem_t *elem,
+									 void *data)
 {
-	const char *p = str;
+	struct ndm_telnet_status_t *st = &((struct ndm_telnet_t *) data)->status;
+	const struct ndm_xml_attr_t *a;
 
-	while (*p != '\0') {
-		if (*p == '\n') {
+	if (elem->parent == NULL) {
+		__ndm_telnet_status_root(st, elem->name);
+		return;
+	}
+
+	if (elem->parent->parent != NULL) {
+		return;
+	}
+
+	__ndm_telnet_status_child(st, elem->name);
+
+	if (st->elem == NDM_TELNET_STATUS_NONE) {
+		return;
+	}
+
+	for (a = elem->attributes.head; a != NULL; a = a->next) {
+		__ndm_telnet_status_child_attr(st, a->name, a->value);
+	}
+
+	__ndm_telnet_status_child_end(st, elem->value);
+}
+
+static inline const char *
+__ndm_telnet_status_text(const struct ndm_telnet_status_msg_t *m)
+{
+	if (m->value != NULL) {
+		return m->value;
+	}
+
+	return (ndm_str_len(&m->text) == 0) ? "" : ndm_str_ptr(&m->text);
+}
+
+/* the same status as __ndm_telnet_recv() finds in a whole document */
+static enum ndm_telnet_err_t
+__ndm_telnet_status_get(const struct ndm_telnet_status_t *st,
+						bool *continued,
+						ndm_code_t *response_code,
+						const char **response_text)
+{
+	const struct ndm_telnet_status_msg_t *m =
+		&st->msgs[NDM_TELNET_STATUS_MESSAGE];
+	const struct ndm_telnet_status_msg_t *e =
+		&st->msgs[NDM_TELNET_STATUS_ERROR];
+
+	if (st->oom) {
+		return NDM_TELNET_ERR_OOM;
+	}
+
+	if (st->event) {
+		*response_text = "";
+		return NDM_TELNET_ERR_OK;
+	}
+
+	if (st->bad || m->bad) {
+		return NDM_TELNET_ERR_RESPONSE_FORMAT;
+	}
+
+	if (m->seen) {
+		*response_code = m->code;
+		*response_text = __ndm_telnet_status_text(m);
+	}
+
+	if (*response_code == 0) {
+		if (e->bad) {
+			return NDM_TELNET_ERR_RESPONSE_FORMAT;
+		}
+
+		if (e->seen) {
+			*response_code = e->code;
+			*response_text = __ndm_telnet_status_text(e);
+		}
+	}
+
+	if (*response_text == NULL && st->prompt) {
+		*response_text = "";
+	}
+
+	if (st->continued) {
+		*continued = true;
+
+		if (*response_text == NULL) {
+			*response_text = "";
+		}
+	}
+
+	if (*response_text == NULL) {
+		return NDM_TELNET_ERR_RESPONSE_FORMAT;
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_recv(struct ndm_telnet_t *telnet,
+				  struct ndm_xml_filter_t *filter,
+				  bool *continued,
+				  ndm_code_t *response_code,
+				  const char **response_text,
+				  struct ndm_xml_elem_t **response)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+	*response = NULL;
+
+	if (telnet->dom.depth > 0) {
+		/* a response is being streamed */
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
+
+	if (telnet->dom.root == NULL) {
+		/* a partially received response keeps its filter and status */
+		ndm_xml_dom_set_filter(&telnet->dom, filter);
+		__ndm_telnet_status_reset(&telnet->status);
+	}
+
+	while (*response == NULL) {
+		enum ndm_xml_err_t xml_err = NDM_XML_ERR_OK;
+		size_t parsed_size = 0;
+		size_t avail;
+
+		if (ndm_buf_len(&telnet->in) == 0) {
+			err = __ndm_telnet_fill(telnet);
+
+			if (err == NDM_TELNET_ERR_AGAIN) {
+				return err;
+			}
+
+			if (err != NDM_TELNET_ERR_OK) {
+				goto error;
+			}
+		}
+
+		avail = ndm_buf_len(&telnet->in);
+		xml_err = ndm_xml_dom_parse(telnet->in.r, avail,
+									&telnet->dom, &parsed_size, response);
+
+		if (xml_err != NDM_XML_ERR_OK) {
+			err = __ndm_telnet_xml_err(xml_err);
+			goto error;
+		}
+
+		ndm_buf_consume(&telnet->in, parsed_size);
+	}
+
+	err = __ndm_telnet_status_get(&telnet->status, continued,
+								  response_code, response_text);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		goto error;
+	}
+
+	if (!telnet->status.event && !*continued) {
+		__ndm_telnet_response_done(telnet);
+	}
+
+	return NDM_TELNET_ERR_OK;
+
+error:
+	if (err == NDM_TELNET_ERR_RESPONSE_FORMAT &&
+		!telnet->status.continued) {
+		/* a whole response was read anyway */
+		__ndm_telnet_response_done(telnet);
+	}
+
+	ndm_xml_dom_reset(&telnet->dom);
+	ndm_xml_doc_free(response);
+
+	/* a wrong intermediate response is followed by a next one */
+	*continued = (err == NDM_TELNET_ERR_RESPONSE_FORMAT &&
+				  telnet->status.continued);
+	*response_code = 0;
+	*response_text = NULL;
+	*response = NULL;
+
+	return err;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_recv_stream(struct ndm_telnet_t *telnet,
+						 bool *continued,
+						 ndm_code_t *response_code,
+						 const char **response_text)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	bool done = false;
+
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+
+	while (!done) {
+		enum ndm_xml_err_t xml_err = NDM_XML_ERR_OK;
+		size_t parsed_size = 0;
+
+		if (ndm_buf_len(&telnet->in) == 0) {
+			err = __ndm_telnet_fill(telnet);
+
+			if (err == NDM_TELNET_ERR_AGAIN) {
+				return err;
+			}
+
+			if (err != NDM_TELNET_ERR_OK) {
+				goto error;
+			}
+		}
+
+		xml_err = ndm_xml_sax_parse(telnet->in.r, ndm_buf_len(&telnet->in),
+									&telnet->dom, &NDM_TELNET_STATUS_SAX,
+									telnet, &parsed_size, &done);
+
+		if (xml_err != NDM_XML_ERR_OK) {
+			err = __ndm_telnet_xml_err(xml_err);
+			goto error;
+		}
+
+		ndm_buf_consume(&telnet->in, parsed_size);
+	}
+
+	err = __ndm_telnet_status_get(&telnet->status, continued,
+								  response_code, response_text);
+
+	if (telnet->status.event) {
+		return err;
+	}
+
+	if (err == NDM_TELNET_ERR_RESPONSE_FORMAT ||
+		(err == NDM_TELNET_ERR_OK && !*continued)) {
+		/* a whole response was read anyway */
+		__ndm_telnet_response_done(telnet);
+	}
+
+	if (err == NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+error:
+	ndm_xml_dom_reset(&telnet->dom);
+
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+
+	return err;
+}
+
+static void __ndm_telnet_status_token(struct ndm_telnet_t *telnet,
+									  const struct ndm_xml_token_t *token)
+{
+	switch (token->type) {
+		case NDM_XML_TOKEN_NONE: {
+			break;
+		}
+
+		case NDM_XML_TOKEN_ELEM_START: {
+			__ndm_telnet_status_elem_start(token->name, token->depth, telnet);
+			break;
+		}
+
+		case NDM_XML_TOKEN_ATTR: {
+			__ndm_telnet_status_attr(token->name, token->value,
+									 token->value_len, token->depth, telnet);
+			break;
+		}
+
+		case NDM_XML_TOKEN_CONTENT: {
+			__ndm_telnet_status_content(token->value, token->value_len,
+										token->depth, telnet);
+			break;
+		}
+
+		case NDM_XML_TOKEN_ELEM_END: {
+			__ndm_telnet_status_elem_end(token->name, token->depth, telnet);
+			break;
+		}
+
+		default: {
+			break;
+		}
+	}
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_cursor_next(struct ndm_telnet_t *telnet,
+						 struct ndm_xml_token_t *token,
+						 bool *continued,
+						 ndm_code_t *response_code,
+						 const char **response_text)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+
+	do {
+		enum ndm_xml_err_t xml_err = NDM_XML_ERR_OK;
+		size_t parsed_size = 0;
+
+		if (ndm_buf_len(&telnet->in) == 0) {
+			err = __ndm_telnet_fill(telnet);
+
+			if (err == NDM_TELNET_ERR_AGAIN) {
+				return err;
+			}
+
+			if (err != NDM_TELNET_ERR_OK) {
+				goto error;
+			}
+		}
+
+		/* a token may point into the buffer until a next fill */
+		xml_err = ndm_xml_cursor_next(telnet->in.r, ndm_buf_len(&telnet->in),
+									  &telnet->dom, &parsed_size, token);
+
+		if (xml_err != NDM_XML_ERR_OK) {
+			err = __ndm_telnet_xml_err(xml_err);
+			goto error;
+		}
+
+		ndm_buf_consume(&telnet->in, parsed_size);
+
+		if (token->type == NDM_XML_TOKEN_ELEM_START && token->depth == 0) {
+			telnet->cursor_skip = 0;
+		}
+
+		__ndm_telnet_status_token(telnet, token);
+
+		if (telnet->cursor_skip > 0 &&
+			token->type == NDM_XML_TOKEN_ELEM_END &&
+			telnet->cursor_skip > token->depth) {
+			telnet->cursor_skip = 0;
+			break;
+		}
+	} while (token->type == NDM_XML_TOKEN_NONE || telnet->cursor_skip > 0);
+
+	if (token->type != NDM_XML_TOKEN_ELEM_END || token->depth > 0) {
+		return NDM_TELNET_ERR_OK;
+	}
+
+	err = __ndm_telnet_status_get(&telnet->status, continued,
+								  response_code, response_text);
+
+	if (telnet->status.event) {
+		return err;
+	}
+
+	if (err == NDM_TELNET_ERR_RESPONSE_FORMAT ||
+		(err == NDM_TELNET_ERR_OK && !*continued)) {
+		/* a whole response was read anyway */
+		__ndm_telnet_response_done(telnet);
+	}
+
+	if (err == NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+error:
+	ndm_xml_dom_reset(&telnet->dom);
+	telnet->cursor_skip = 0;
+	token->type = NDM_XML_TOKEN_NONE;
+
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+
+	return err;
+}
+
+static inline bool
+__ndm_telnet_has_lf(const char *const str)
+{
+	const char *p = str;
+
+	while (*p != '\0') {
+		if (*p == '\n') {
 			return true;
 		}
 
-		p++;
-	}
+		p++;
+	}
+
+	return false;
+}
+
+static inline bool
+__ndm_telnet_is_unicast(const struct in_addr *const addr)
+{
+	const unsigned long a = ntohl(addr->s_addr);
+
+	if (a == 0x00000000 || a == 0xffffffff) {
+		return false;
+	}
+
+	return (a & 0xf0000000) != 0xe0000000;
+}
+
+static enum ndm_telnet_err_t __ndm_telnet_connect(struct ndm_telnet_t *telnet)
+{
+	int ret = 0;
+	int error = 0;
+	socklen_t error_len = sizeof(error);
+	ssize_t n = 0;
+
+	do {
+		n = __ndm_telnet_poll(telnet, POLLWRNORM);
+
+		if (n < 0) {
+			if (__ndm_telnet_interrupted(io_error_get())) {
+				continue;
+			}
+
+			return NDM_TELNET_ERR_CONNECT;
+		}
+	} while (n < 0);
+
+	if (n == 0) {
+		return telnet->non_blocking ?
+			NDM_TELNET_ERR_AGAIN :
+			NDM_TELNET_ERR_IO_TIMEOUT;
+	}
+
+	ret = getsockopt(telnet->sock, SOL_SOCKET, SO_ERROR,
+					 (char *) &error, &error_len);
+
+	if (ret < 0 || error_len != sizeof(error) || error != 0) {
+		return NDM_TELNET_ERR_CONNECT;
+	}
+
+	telnet->state = NDM_TELNET_STATE_LOGIN;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_type_ahead(struct ndm_telnet_t *telnet)
+{
+	const char *answers[3];
+	size_t i;
+
+	answers[0] = ndm_str_ptr(&telnet->user);
+	answers[1] = ndm_str_ptr(&telnet->password);
+	answers[2] = NDM_TELNET_RAW_MODE;
+
+	/* all answers are queued to be sent in a single segment */
+	for (i = 0; i < sizeof(answers) / sizeof(answers[0]); i++) {
+		const enum ndm_telnet_err_t err =
+			__ndm_telnet_queue_cmd(telnet, answers[i]);
+
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
+		}
+	}
+
+	telnet->typed_ahead = true;
+
+	return __ndm_telnet_flush(telnet);
+}
+
+static const char *const NDM_TELNET_PROMPTS[] = {
+	NDM_TELNET_LOGIN,
+	NDM_TELNET_PASSWORD,
+	NDM_TELNET_CONFIG,
+	NDM_TELNET_RAW_MODE "\r"
+};
+
+static inline void __ndm_telnet_prompt_reset(struct ndm_telnet_t *telnet)
+{
+	telnet->prompt = NDM_TELNET_PROMPT_NONE;
+	telnet->prompt_pos = 0;
+	telnet->prompt_skip = false;
+}
+
+static enum ndm_telnet_prompt_t
+__ndm_telnet_prompt_step(struct ndm_telnet_t *telnet,
+						 const char c)
+{
+	const size_t pos = telnet->prompt_pos;
+	enum ndm_telnet_prompt_t p = telnet->prompt;
+
+	if (c == '\n') {
+		__ndm_telnet_prompt_reset(telnet);
+		return NDM_TELNET_PROMPT_NONE;
+	}
+
+	if (telnet->prompt_skip) {
+		return NDM_TELNET_PROMPT_NONE;
+	}
+
+	if (pos == 0 || NDM_TELNET_PROMPTS[p][pos] != c) {
+		/* look for another prompt with the same matched prefix */
+		const char *matched = (pos == 0) ? "" : NDM_TELNET_PROMPTS[p];
+		unsigned int i = 0;
+
+		while (i < NDM_TELNET_PROMPT_NONE &&
+			   (strncmp(NDM_TELNET_PROMPTS[i], matched, pos) != 0 ||
+				NDM_TELNET_PROMPTS[i][pos] != c)) {
+			i++;
+		}
+
+		if (i == NDM_TELNET_PROMPT_NONE) {
+			/* not a prompt, wait for a next line */
+			telnet->prompt_skip = true;
+			return NDM_TELNET_PROMPT_NONE;
+		}
+
+		p = (enum ndm_telnet_prompt_t) i;
+		telnet->prompt = p;
+	}
+
+	telnet->prompt_pos = pos + 1;
+
+	if (NDM_TELNET_PROMPTS[p][pos + 1] != '\0') {
+		return NDM_TELNET_PROMPT_NONE;
+	}
+
+	/* an echo or a next prompt may follow on the same line */
+	__ndm_telnet_prompt_reset(telnet);
+
+	return p;
+}
+
+static enum ndm_telnet_prompt_t
+__ndm_telnet_prompt_feed(struct ndm_telnet_t *telnet,
+						 const char c)
+{
+	size_t i;
+
+	/* erase sequences are dropped as they arrive */
+	if (c == NDM_TELNET_ESC[telnet->esc_pos]) {
+		telnet->esc_pos++;
+
+		if (telnet->esc_pos == NDM_TELNET_ESC_LEN) {
+			telnet->esc_pos = 0;
+		}
+
+		return NDM_TELNET_PROMPT_NONE;
+	}
+
+	if (telnet->esc_pos > 0) {
+		/* held back bytes of an incomplete sequence are not a part
+		 * of any prompt, they only break a current match */
+		for (i = 0; i < telnet->esc_pos; i++) {
+			__ndm_telnet_prompt_step(telnet, NDM_TELNET_ESC[i]);
+		}
+
+		telnet->esc_pos = 0;
+
+		if (c == NDM_TELNET_ESC[0]) {
+			telnet->esc_pos = 1;
+			return NDM_TELNET_PROMPT_NONE;
+		}
+	}
+
+	return __ndm_telnet_prompt_step(telnet, c);
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_prompt(struct ndm_telnet_t *telnet,
+					const enum ndm_telnet_prompt_t prompt)
+{
+	/* with typed ahead answers *_sent flags mark answered prompts */
+	switch (prompt) {
+		case NDM_TELNET_PROMPT_LOGIN: {
+			if (telnet->user_sent) {
+				return NDM_TELNET_ERR_WRONG_CREDENTIALS;
+			}
+
+			if (telnet->password_sent) {
+				return NDM_TELNET_ERR_WRONG_STATE;
+			}
+
+			telnet->user_sent = true;
+
+			return telnet->typed_ahead ?
+				NDM_TELNET_ERR_OK :
+				__ndm_telnet_send_cmd(telnet, ndm_str_ptr(&telnet->user));
+		}
+
+		case NDM_TELNET_PROMPT_PASSWORD: {
+			if (!telnet->user_sent ||
+				(telnet->typed_ahead && telnet->password_sent)) {
+				return NDM_TELNET_ERR_WRONG_STATE;
+			}
+
+			telnet->password_sent = true;
+
+			return telnet->typed_ahead ?
+				NDM_TELNET_ERR_OK :
+				__ndm_telnet_send_cmd(telnet,
+									  ndm_str_ptr(&telnet->password));
+		}
+
+		case NDM_TELNET_PROMPT_CONFIG: {
+			if (telnet->user_sent != telnet->password_sent) {
+				return NDM_TELNET_ERR_WRONG_STATE;
+			}
+
+			if (telnet->typed_ahead) {
+				if (!telnet->user_sent) {
+					/* typed ahead credentials were run as commands
+					 * by a device without a login prompt */
+					return NDM_TELNET_ERR_WRONG_STATE;
+				}
+
+				telnet->raw_sent = true;
+				return NDM_TELNET_ERR_OK;
+			}
+
+			if (telnet->raw_sent) {
+				return NDM_TELNET_ERR_RAW_NOT_SUPPORTED;
+			}
+
+			telnet->raw_sent = true;
+
+			return __ndm_telnet_send_cmd(telnet, NDM_TELNET_RAW_MODE);
+		}
+
+		case NDM_TELNET_PROMPT_RAW: {
+			if (!telnet->raw_sent) {
+				return telnet->typed_ahead ?
+					NDM_TELNET_ERR_OK :
+					NDM_TELNET_ERR_WRONG_STATE;
+			}
+
+			telnet->state = NDM_TELNET_STATE_RAW;
+
+			return NDM_TELNET_ERR_OK;
+		}
+
+		case NDM_TELNET_PROMPT_NONE:
+		default: {
+			return NDM_TELNET_ERR_OK;
+		}
+	}
+}
+
+static enum ndm_telnet_err_t __ndm_telnet_login(struct ndm_telnet_t *telnet)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	if (telnet->fast_open && !telnet->typed_ahead) {
+		err = __ndm_telnet_type_ahead(telnet);
+
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
+		}
+	}
+
+	while (telnet->state == NDM_TELNET_STATE_LOGIN) {
+		enum ndm_telnet_prompt_t prompt = NDM_TELNET_PROMPT_NONE;
+		char *p = telnet->in.r;
+		char *end = telnet->in.w;
+
+		if (p == end) {
+			err = __ndm_telnet_fill(telnet);
+
+			if (err != NDM_TELNET_ERR_OK) {
+				return err;
+			}
+
+			continue;
+		}
+
+		/* banner bytes are scanned once and never buffered */
+		while (p < end && prompt == NDM_TELNET_PROMPT_NONE) {
+			if (telnet->prompt_skip) {
+				char *lf = (char *) memchr(p, '\n', (size_t) (end - p));
+
+				if (lf == NULL) {
+					p = end;
+					break;
+				}
+
+				p = lf;
+			}
+
+			prompt = __ndm_telnet_prompt_feed(telnet, *p++);
+		}
+
+		/* data after a raw mode echo is a response */
+		ndm_buf_consume(&telnet->in, (size_t) (p - telnet->in.r));
+		err = __ndm_telnet_prompt(telnet, prompt);
+
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
+		}
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t __ndm_telnet_raw(struct ndm_telnet_t *telnet)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	while (telnet->state == NDM_TELNET_STATE_RAW) {
+		char *p;
+		char *s;
+
+		if (ndm_buf_len(&telnet->in) >= NDM_TELNET_CONFIG_LEN &&
+			strncmp(telnet->in.r, NDM_TELNET_CONFIG,
+					NDM_TELNET_CONFIG_LEN) == 0) {
+			return NDM_TELNET_ERR_RAW_NOT_SUPPORTED;
+		}
+
+		p = telnet->in.r;
+
+		while (p < telnet->in.w && *p != '\n') {
+			p++;
+		}
+
+		if (p == telnet->in.w) {
+			err = __ndm_telnet_fill(telnet);
+
+			if (err == NDM_TELNET_ERR_BUFFER_OVERFLOW) {
+				/* no ESC sequence or string without it */
+				return NDM_TELNET_ERR_UNKNOWN_PROTOCOL;
+			}
+
+			if (err != NDM_TELNET_ERR_OK) {
+				return err;
+			}
+
+			/* continue to fill the buffer */
+			continue;
+		}
+
+		/* a newline delimiter found */
+		s = telnet->in.r;
+
+		while (s < p && isspace(*s)) {
+			s++;
+		}
+
+		if (*s == '\n') {
+			/* skip an empty string */
+			ndm_buf_consume(&telnet->in, (size_t) (s + 1 - telnet->in.r));
+			continue;
+		}
+
+		if ((size_t) (telnet->in.w - s) < NDM_TELNET_RESPONSE_LEN ||
+			strncmp(s, NDM_TELNET_RESPONSE, NDM_TELNET_RESPONSE_LEN) != 0) {
+			return NDM_TELNET_ERR_RAW_NOT_SUPPORTED;
+		}
+
+		telnet->state = NDM_TELNET_STATE_RAW_RESPONSE;
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t
+__ndm_telnet_raw_response(struct ndm_telnet_t *telnet)
+{
+	bool continued = false;
+	ndm_code_t response_code = 0;
+	const char *response_text = NULL;
+	struct ndm_xml_elem_t *response = NULL;
+	const enum ndm_telnet_err_t err =
+		__ndm_telnet_recv(telnet, NULL, &continued, &response_code,
+						  &response_text, &response);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+	ndm_xml_doc_free(&response);
+
+	if (NDM_FAILED(response_code)) {
+		return NDM_TELNET_ERR_RAW_FAILED;
+	}
+
+	/* credentials are not needed anymore */
+	ndm_str_free(&telnet->user);
+	ndm_str_free(&telnet->password);
+
+	telnet->pending = 0;
+	telnet->state = NDM_TELNET_STATE_READY;
+
+	return NDM_TELNET_ERR_OK;
+}
+
+static enum ndm_telnet_err_t __ndm_telnet_handshake(struct ndm_telnet_t *telnet)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+
+	while (err == NDM_TELNET_ERR_OK &&
+		   telnet->state != NDM_TELNET_STATE_READY) {
+		switch (telnet->state) {
+			case NDM_TELNET_STATE_CONNECT: {
+				err = __ndm_telnet_connect(telnet);
+				break;
+			}
+
+			case NDM_TELNET_STATE_LOGIN: {
+				err = __ndm_telnet_login(telnet);
+				break;
+			}
+
+			case NDM_TELNET_STATE_RAW: {
+				err = __ndm_telnet_raw(telnet);
+				break;
+			}
+
+			case NDM_TELNET_STATE_RAW_RESPONSE: {
+				err = __ndm_telnet_raw_response(telnet);
+				break;
+			}
+
+			case NDM_TELNET_STATE_READY:
+			default: {
+				err = NDM_TELNET_ERR_INTERNAL_ERROR;
+				break;
+			}
+		}
+	}
+
+	return err;
+}
+
+void ndm_telnet_opts_init(struct ndm_telnet_opts_t *opts)
+{
+	opts->flags = 0;
+	opts->buffer_size = NDM_TELNET_DEF_BUFFER_SIZE;
+	opts->max_buffer_size = NDM_TELNET_DEF_MAX_BUFFER_SIZE;
+	opts->arena = NULL;
+	opts->symtab = NULL;
+}
+
+enum ndm_telnet_err_t ndm_telnet_open(struct ndm_telnet_t **telnet,
+									  const struct sockaddr_in *const sin,
+									  const char *const user,
+									  const char *const password,
+									  const unsigned int timeout)
+{
+	return ndm_telnet_open_ex(telnet, sin, user, password, timeout, NULL);
+}
+
+enum ndm_telnet_err_t ndm_telnet_open_ex(struct ndm_telnet_t **telnet,
+										 const struct sockaddr_in *const sin,
+										 const char *const user,
+										 const char *const password,
+										 const unsigned int timeout,
+										 const struct ndm_telnet_opts_t *opts)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	struct ndm_telnet_t *t = NULL;
+	struct ndm_telnet_opts_t def_opts;
+	int enable = 1;
+	size_t i;
+	static const telnet_telopt_t TELOPTS[] = {
+		{ -1, 0, 0 }
+	};
+
+	*telnet = NULL;
+
+	if (opts == NULL) {
+		ndm_telnet_opts_init(&def_opts);
+		opts = &def_opts;
+	}
+
+	if (!__ndm_telnet_is_unicast(&sin->sin_addr)) {
+		return NDM_TELNET_ERR_ADDRESS;
+	}
+
+	if (sin->sin_port == 0) {
+		return NDM_TELNET_ERR_PORT;
+	}
+
+	if (__ndm_telnet_has_lf(user)) {
+		return NDM_TELNET_ERR_USER;
+	}
+
+	if (__ndm_telnet_has_lf(password)) {
+		return NDM_TELNET_ERR_PASSWORD;
+	}
+
+	if (timeout < NDM_TELNET_MIN_TIMEOUT) {
+		return NDM_TELNET_ERR_TIMEOUT_SMALL;
+	}
+
+	if (timeout > NDM_TELNET_MAX_TIMEOUT) {
+		return NDM_TELNET_ERR_TIMEOUT_LARGE;
+	}
+
+	if (opts->buffer_size < NDM_TELNET_MIN_BUFFER_SIZE ||
+		opts->max_buffer_size < opts->buffer_size) {
+		return NDM_TELNET_ERR_BUFFER_SIZE;
+	}
+
+	t = (struct ndm_telnet_t *) malloc(sizeof(*t));
+
+	if (t == NULL) {
+		return NDM_TELNET_ERR_OOM;
+	}
+
+	t->sock = -1;
+	t->stream = NULL;
+	t->non_blocking = (opts->flags & NDM_TELNET_FLAG_NON_BLOCKING) != 0;
+	t->external_io = t->non_blocking &&
+		(opts->flags & NDM_TELNET_FLAG_EXTERNAL_IO) != 0;
+	t->optimistic_io = (opts->flags & NDM_TELNET_FLAG_OPTIMISTIC_IO) != 0;
+	t->fast_open = (opts->flags & NDM_TELNET_FLAG_FAST_OPEN) != 0;
+	t->typed_ahead = false;
+	t->state = NDM_TELNET_STATE_CONNECT;
+	t->pending = 0;
+	t->user_sent = false;
+	t->password_sent = false;
+	t->raw_sent = false;
+	t->esc_pos = 0;
+	__ndm_telnet_prompt_reset(t);
+	t->arena = opts->arena;
+
+	/* a parser state is kept between non-blocking calls
+	 * and reused for all responses */
+	ndm_xml_dom_init_ex(&t->dom, t->arena);
+	ndm_xml_dom_set_symtab(&t->dom, opts->symtab);
+	ndm_xml_dom_set_end_fn(&t->dom, __ndm_telnet_status_elem, t);
+
+	if (opts->flags & NDM_TELNET_FLAG_XML_VIEWS) {
+		ndm_xml_dom_set_flags(&t->dom, NDM_XML_DOM_FLAG_VIEWS);
+	}
+
+	ndm_str_init(&t->out, NDM_TELNET_OUT_STP);
+	ndm_str_init(&t->user, NDM_TELNET_STR_STP);
+	ndm_str_init(&t->password, NDM_TELNET_STR_STP);
+	__ndm_telnet_status_init(&t->status);
+	t->cursor_skip = 0;
+	ndm_xml_filter_init(&t->filter);
+
+	for (i = 0; i < NDM_TELNET_STATUS_QUERIES; i++) {
+		t->status_queries[i] = NULL;
+	}
+
+	ndm_buf_init(&t->in);
+	memset(&t->stats, 0, sizeof(t->stats));
+
+	/* a non-blocking handshake outlives caller's strings */
+	if (!ndm_str_append(&t->user, user, strlen(user)) ||
+		!ndm_str_append(&t->password, password, strlen(password))) {
+		err = NDM_TELNET_ERR_OOM;
+		goto error;
+	}
+
+	if (!ndm_buf_alloc(&t->in, opts->buffer_size,
+					   (opts->flags & NDM_TELNET_FLAG_RING_BUFFER) != 0)) {
+		err = NDM_TELNET_ERR_OOM;
+		goto error;
+	}
+
+	/* a mirrored storage is page aligned */
+	t->in_size = t->in.cap;
+	t->in_max_size = opts->max_buffer_size;
+	t->in_full = false;
+	t->in_lock = NULL;
+	t->in_lock_size = 0;
+
+	t->stream = telnet_init(TELOPTS, __ndm_telnet_event, 0, t);
+
+	if (t->stream == NULL) {
+		err = NDM_TELNET_ERR_TELNET;
+		goto error;
+	}
+
+	t->stream_err = NDM_TELNET_ERR_OK;
+	t->io_timeout = timeout;
+	t->io_now = -1;
+	t->io_deadline = __ndm_telnet_clock(t) + timeout;
+	t->sock = socket(sin->sin_family, SOCK_STREAM, 0);
+
+	if (t->sock < 0) {
+		err = NDM_TELNET_ERR_SOCKET;
+		goto error;
+	}
+
+	if (setsockopt(t->sock, SOL_TCP, TCP_NODELAY,
+				   (char *) &enable, sizeof(enable)) < 0) {
+		err = NDM_TELNET_ERR_SETUP;
+		goto error;
+	}
+
+	if (!__ndm_telnet_set_non_blocking(t)) {
+		err = NDM_TELNET_ERR_NON_BLOCK;
+		goto error;
+	}
+
+	if (connect(t->sock, (struct sockaddr *) sin, sizeof(*sin)) < 0) {
+		if (io_error_get() != IO_ERROR_EWOULDBLOCK &&
+			io_error_get() != IO_ERROR_EINPROGRESS) {
+			err = NDM_TELNET_ERR_CONNECT;
+			goto error;
+		}
+	} else {
+		t->state = NDM_TELNET_STATE_LOGIN;
+	}
+
+	if (t->non_blocking) {
+		/* the handshake is driven by ndm_telnet_process() */
+		*telnet = t;
+
+		return NDM_TELNET_ERR_AGAIN;
+	}
+
+	err = __ndm_telnet_handshake(t);
+
+error:
+	if (err != NDM_TELNET_ERR_OK) {
+		ndm_telnet_close(&t);
+	}
+
+	*telnet = t;
+
+	return err;
+}
+
+enum ndm_telnet_err_t ndm_telnet_check_command(const char *const command)
+{
+	const char *p = command;
+
+	while (isspace(*p)) {
+		p++;
+	}
+
+	if (*p == '\0') {
+		return NDM_TELNET_ERR_NO_COMMAND;
+	}
+
+	if (__ndm_telnet_has_lf(command)) {
+		return NDM_TELNET_ERR_COMMAND;
+	}
+
+	return NDM_TELNET_ERR_OK;
+}
+
+enum ndm_telnet_err_t ndm_telnet_send(struct ndm_telnet_t *telnet,
+									  const char *const command,
+									  const unsigned int timeout)
+{
+	const enum ndm_telnet_err_t err = ndm_telnet_check_command(command);
+
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
+	}
+
+	if (telnet->state != NDM_TELNET_STATE_READY) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
+
+	telnet->io_now = -1;
+
+	/* pipelined non-blocking commands share the oldest one deadline */
+	if (!telnet->non_blocking || telnet->pending == 0) {
+		telnet->io_timeout = timeout;
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + timeout;
+	}
+
+	__ndm_telnet_shrink(telnet);
+
+	return __ndm_telnet_send_cmd(telnet, command);
+}
+
+enum ndm_telnet_err_t ndm_telnet_recv(struct ndm_telnet_t *telnet,
+									  bool *continued,
+									  ndm_code_t *response_code,
+									  const char **response_text,
+									  struct ndm_xml_elem_t **response,
+									  const unsigned int timeout)
+{
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+	*response = NULL;
+
+	if (telnet->state != NDM_TELNET_STATE_READY) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
+
+	telnet->io_now = -1;
+
+	if (!telnet->non_blocking) {
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + timeout;
+	}
+
+	return __ndm_telnet_recv(telnet, NULL, continued, response_code,
+							 response_text, response);
+}
+
+enum ndm_telnet_err_t
+ndm_telnet_recv_filtered(struct ndm_telnet_t *telnet,
+						 const struct ndm_xml_query_t *const *queries,
+						 const size_t query_count,
+						 bool *continued,
+						 ndm_code_t *response_code,
+						 const char **response_text,
+						 struct ndm_xml_elem_t **response,
+						 const unsigned int timeout)
+{
+	size_t i;
+
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+	*response = NULL;
+
+	if (telnet->state != NDM_TELNET_STATE_READY) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
+
+	if (telnet->dom.root == NULL) {
+		/* status nodes are always kept */
+		ndm_xml_filter_clear(&telnet->filter);
+
+		for (i = 0; i < NDM_TELNET_STATUS_QUERIES; i++) {
+			enum ndm_xml_err_t xml_err = NDM_XML_ERR_OK;
+
+			if (telnet->status_queries[i] == NULL) {
+				xml_err = ndm_xml_query_compile(NDM_TELNET_STATUS_PATHS[i],
+												&telnet->status_queries[i]);
+			}
+
+			if (xml_err == NDM_XML_ERR_OK) {
+				xml_err = ndm_xml_filter_add(&telnet->filter,
+											 telnet->status_queries[i]);
+			}
+
+			if (xml_err != NDM_XML_ERR_OK) {
+				return __ndm_telnet_xml_err(xml_err);
+			}
+		}
+
+		for (i = 0; i < query_count; i++) {
+			const enum ndm_xml_err_t xml_err =
+				ndm_xml_filter_add(&telnet->filter, queries[i]);
 
-	return false;
-}
+			if (xml_err != NDM_XML_ERR_OK) {
+				return __ndm_telnet_xml_err(xml_err);
+			}
+		}
+	}
 
-static inline bool
-__ndm_telnet_is_unicast(const struct in_addr *const addr)
-{
-	const unsigned long a = ntohl(addr->s_addr);
+	telnet->io_now = -1;
 
-	if (a == 0x00000000 || a == 0xffffffff) {
-		return false;
+	if (!telnet->non_blocking) {
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + timeout;
 	}
 
-	return (a & 0xf0000000) != 0xe0000000;
+	return __ndm_telnet_recv(telnet, &telnet->filter, continued,
+							 response_code, response_text, response);
 }
 
-enum ndm_telnet_err_t ndm_telnet_open(struct ndm_telnet_t **telnet,
-									  const struct sockaddr_in *const sin,
-									  const char *const user,
-									  const char *const password,
-									  const unsigned int timeout)
+enum ndm_telnet_err_t ndm_telnet_recv_stream(struct ndm_telnet_t *telnet,
+											 const struct ndm_xml_sax_t *sax,
+											 void *data,
+											 bool *continued,
+											 ndm_code_t *response_code,
+											 const char **response_text,
+											 const unsigned int timeout)
 {
-	struct ndm_str_t str;
-	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
-	bool user_sent = false;
-	bool password_sent = false;
-	bool raw_sent = false;
-	bool raw_recv = false;
-	bool continued = 0;
-	ndm_code_t response_code = 0;
-	const char *response_text = NULL;
-	struct ndm_xml_elem_t *response = NULL;
-	struct ndm_telnet_t *t = NULL;
-	int enable = 1;
-	static const telnet_telopt_t TELOPTS[] = {
-		{ -1, 0, 0 }
-	};
-
-	ndm_str_init(&str, NDM_TELNET_STR_STP);
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
 
-	if (!__ndm_telnet_is_unicast(&sin->sin_addr)) {
-		return NDM_TELNET_ERR_ADDRESS;
+	if (telnet->state != NDM_TELNET_STATE_READY ||
+		telnet->dom.root != NULL) {
+		return NDM_TELNET_ERR_WRONG_CALL;
 	}
 
-	if (sin->sin_port == 0) {
-		return NDM_TELNET_ERR_PORT;
-	}
+	telnet->io_now = -1;
 
-	if (__ndm_telnet_has_lf(user)) {
-		return NDM_TELNET_ERR_USER;
+	if (!telnet->non_blocking) {
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + timeout;
 	}
 
-	if (__ndm_telnet_has_lf(password)) {
-		return NDM_TELNET_ERR_PASSWORD;
-	}
+	telnet->status.sax = sax;
+	telnet->status.data = data;
 
-	if (timeout < NDM_TELNET_MIN_TIMEOUT) {
-		return NDM_TELNET_ERR_TIMEOUT_SMALL;
-	}
+	return __ndm_telnet_recv_stream(telnet, continued, response_code,
+									response_text);
+}
 
-	if (timeout > NDM_TELNET_MAX_TIMEOUT) {
-		return NDM_TELNET_ERR_TIMEOUT_LARGE;
+enum ndm_telnet_err_t ndm_telnet_cursor_next(struct ndm_telnet_t *telnet,
+											 struct ndm_xml_token_t *token,
+											 bool *continued,
+											 ndm_code_t *response_code,
+											 const char **response_text,
+											 const unsigned int timeout)
+{
+	*continued = false;
+	*response_code = 0;
+	*response_text = NULL;
+	token->type = NDM_XML_TOKEN_NONE;
+
+	if (telnet->state != NDM_TELNET_STATE_READY ||
+		telnet->dom.root != NULL) {
+		return NDM_TELNET_ERR_WRONG_CALL;
 	}
 
-	t = (struct ndm_telnet_t *) malloc(sizeof(*t) + NDM_TELNET_BUFFER_SIZE);
+	telnet->io_now = -1;
 
-	if (t == NULL) {
-		return NDM_TELNET_ERR_OOM;
+	if (!telnet->non_blocking) {
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + timeout;
 	}
 
-	t->stream = telnet_init(TELOPTS, __ndm_telnet_event, 0, t);
+	telnet->status.sax = NULL;
+	telnet->status.data = NULL;
 
-	if (t->stream == NULL) {
-		err = NDM_TELNET_ERR_TELNET;
-		goto error;
-	}
+	return __ndm_telnet_cursor_next(telnet, token, continued,
+									response_code, response_text);
+}
 
-	t->stream_err = NDM_TELNET_ERR_OK;
-	t->io_deadline = ndm_telnet_now() + timeout;
-	t->buf_r = t->buf;
-	t->buf_w = t->buf;
-	t->buf_e = t->buf + NDM_TELNET_BUFFER_SIZE;
-	t->sock = socket(sin->sin_family, SOCK_STREAM, 0);
+void ndm_telnet_cursor_skip(struct ndm_telnet_t *telnet)
+{
+	const struct ndm_telnet_status_t *st = &telnet->status;
 
-	if (t->sock < 0) {
-		err = NDM_TELNET_ERR_SOCKET;
-		goto error;
+	if ((telnet->dom.depth == 1 && !st->event) ||
+		(telnet->dom.depth == 2 && st->elem != NDM_TELNET_STATUS_NONE)) {
+		/* a status is still collected from hidden tokens */
+		telnet->cursor_skip = telnet->dom.depth;
+		return;
 	}
 
-	if (setsockopt(t->sock, SOL_TCP, TCP_NODELAY,
-				   (char *) &enable, sizeof(enable)) < 0) {
-		err = NDM_TELNET_ERR_SETUP;
-		goto error;
-	}
+	ndm_xml_cursor_skip(&telnet->dom);
+}
 
-	if (!__ndm_telnet_set_non_blocking(t)) {
-		err = NDM_TELNET_ERR_NON_BLOCK;
-		goto error;
-	}
+int ndm_telnet_fd(const struct ndm_telnet_t *telnet)
+{
+	return telnet->sock;
+}
 
-	if (connect(t->sock, (struct sockaddr *) sin, sizeof(*sin)) < 0) {
-		int ret = 0;
-		int error = 0;
-		socklen_t error_len = sizeof(error);
-		ssize_t n = 0;
+unsigned int ndm_telnet_interest(const struct ndm_telnet_t *telnet)
+{
+	if (telnet->state == NDM_TELNET_STATE_CONNECT) {
+		return NDM_TELNET_IO_WRITE;
+	}
 
-		if (io_error_get() != IO_ERROR_EWOULDBLOCK &&
-			io_error_get() != IO_ERROR_EINPROGRESS) {
-			err = NDM_TELNET_ERR_CONNECT;
-			goto error;
-		}
+	if (ndm_str_len(&telnet->out) > 0) {
+		return NDM_TELNET_IO_READ | NDM_TELNET_IO_WRITE;
+	}
 
-		do {
-			n = __ndm_telnet_poll(t, POLLWRNORM);
+	return NDM_TELNET_IO_READ;
+}
 
-			if (n < 0) {
-				if (__ndm_telnet_interrupted(io_error_get())) {
-					continue;
-				}
+int64_t ndm_telnet_deadline(const struct ndm_telnet_t *telnet)
+{
+	if (telnet->state != NDM_TELNET_STATE_READY || telnet->pending > 0) {
+		return telnet->io_deadline;
+	}
 
-				err = NDM_TELNET_ERR_CONNECT;
-				goto error;
-			}
-		} while (n < 0);
+	return -1;
+}
 
-		if (n == 0) {
-			err = NDM_TELNET_ERR_IO_TIMEOUT;
-			goto error;
-		}
+enum ndm_telnet_err_t ndm_telnet_recv_buffer(struct ndm_telnet_t *telnet,
+											char **data,
+											size_t *size)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
 
-		ret = getsockopt(t->sock, SOL_SOCKET, SO_ERROR,
-						 (char *) &error, &error_len);
+	*data = NULL;
+	*size = 0;
 
-		if (ret < 0 || error_len != sizeof(error) || error != 0) {
-			err = NDM_TELNET_ERR_CONNECT;
-			goto error;
-		}
+	if (!telnet->external_io || telnet->in_lock != NULL) {
+		return NDM_TELNET_ERR_WRONG_CALL;
 	}
 
-	while (!raw_recv) {
-		char *e;
-		bool clear = false;
+	err = __ndm_telnet_reserve(telnet, size);
 
-		if (t->buf_r == t->buf_w) {
-			err = __ndm_telnet_fill(t);
+	if (err != NDM_TELNET_ERR_OK) {
+		return err;
+	}
 
-			if (err != NDM_TELNET_ERR_OK) {
-				goto error;
-			}
-		}
+	/* the storage should not move until the data is committed */
+	telnet->in_lock = telnet->in.w;
+	telnet->in_lock_size = *size;
+	*data = telnet->in_lock;
 
-		e = t->buf_r;
+	return NDM_TELNET_ERR_OK;
+}
 
-		while (e < t->buf_w && *e != '\n') {
-			e++;
-		}
+enum ndm_telnet_err_t ndm_telnet_recv_commit(struct ndm_telnet_t *telnet,
+											const size_t size)
+{
+	char *in = telnet->in_lock;
 
-		if (!ndm_str_append(&str, t->buf_r, (size_t) (e - t->buf_r))) {
-			err = NDM_TELNET_ERR_OOM;
-			goto error;
-		}
+	if (in == NULL || size > telnet->in_lock_size) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
 
-		if (e < t->buf_w) {
-			t->buf_r = e + 1; /* skip a whole string with a newline */
-			clear = true;
-		} else {
-			t->buf_r = t->buf_w;
-		}
+	telnet->in_lock = NULL;
 
-		__ndm_telnet_remove_esc(&str);
+	if (size == 0) {
+		return NDM_TELNET_ERR_DISCONNECTED;
+	}
 
-		if (strcmp(ndm_str_ptr(&str), NDM_TELNET_LOGIN) == 0) {
-			if (user_sent) {
-				err = NDM_TELNET_ERR_WRONG_CREDENTIALS;
-				goto error;
-			}
+	/* a write position may have been reset while receiving,
+	 * and the event handler moves data back to it */
+	return __ndm_telnet_received(telnet, in, telnet->in_lock_size, size);
+}
 
-			if (password_sent) {
-				err = NDM_TELNET_ERR_WRONG_STATE;
-				goto error;
-			}
+void ndm_telnet_recv_detach(struct ndm_telnet_t *telnet)
+{
+	if (telnet->in_lock == NULL) {
+		return;
+	}
 
-			err = __ndm_telnet_send_cmd(t, user);
+	/* the storage is leaked, as it may still be written */
+	telnet->in_lock = NULL;
+	ndm_buf_init(&telnet->in);
+}
 
-			if (err != NDM_TELNET_ERR_OK) {
-				goto error;
-			}
+size_t ndm_telnet_send_buffer(const struct ndm_telnet_t *telnet,
+							  const char **data)
+{
+	*data = ndm_str_ptr(&telnet->out);
 
-			clear = true;
-			user_sent = true;
-		} else if (strcmp(ndm_str_ptr(&str), NDM_TELNET_PASSWORD) == 0) {
-			if (!user_sent) {
-				err = NDM_TELNET_ERR_WRONG_STATE;
-				goto error;
-			}
+	return ndm_str_len(&telnet->out);
+}
 
-			err = __ndm_telnet_send_cmd(t, password);
+enum ndm_telnet_err_t ndm_telnet_send_commit(struct ndm_telnet_t *telnet,
+											const size_t size)
+{
+	if (size > ndm_str_len(&telnet->out)) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
 
-			if (err != NDM_TELNET_ERR_OK) {
-				goto error;
-			}
+	if (size == ndm_str_len(&telnet->out)) {
+		ndm_str_clear(&telnet->out);
+	} else {
+		ndm_str_erase(&telnet->out, 0, size);
+	}
 
-			clear = true;
-			password_sent = true;
-		} else if (strcmp(ndm_str_ptr(&str), NDM_TELNET_CONFIG) == 0) {
-			if (( user_sent && !password_sent) ||
-				(!user_sent &&  password_sent)) {
-				err = NDM_TELNET_ERR_WRONG_STATE;
-				goto error;
-			}
+	telnet->stats.sends++;
+	telnet->stats.bytes_sent += (uint64_t) size;
 
-			err = __ndm_telnet_send_cmd(t, NDM_TELNET_RAW_MODE);
+	return NDM_TELNET_ERR_OK;
+}
 
-			if (err != NDM_TELNET_ERR_OK) {
-				goto error;
-			}
+enum ndm_telnet_err_t ndm_telnet_process(struct ndm_telnet_t *telnet,
+										 struct ndm_telnet_response_t *response)
+{
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
 
-			if (raw_sent) {
-				err = NDM_TELNET_ERR_RAW_NOT_SUPPORTED;
-				goto error;
+	response->err = NDM_TELNET_ERR_OK;
+	response->continued = false;
+	response->code = 0;
+	response->text = NULL;
+	response->root = NULL;
+	telnet->io_now = -1;
+
+	if (telnet->state != NDM_TELNET_STATE_READY) {
+		err = __ndm_telnet_flush(telnet);
+
+		if (err == NDM_TELNET_ERR_OK && ndm_str_len(&telnet->out) > 0) {
+			/* a device waits for the rest of a handshake line */
+			err = NDM_TELNET_ERR_AGAIN;
+		} else if (err == NDM_TELNET_ERR_OK) {
+			err = __ndm_telnet_handshake(telnet);
+		}
+	} else {
+		err = __ndm_telnet_flush(telnet);
+
+		if (err == NDM_TELNET_ERR_OK) {
+			err = __ndm_telnet_recv(telnet, NULL, &response->continued,
+									&response->code, &response->text,
+									&response->root);
+
+			if (err == NDM_TELNET_ERR_RESPONSE_FORMAT) {
+				/* the response was read completely, keep on */
+				response->err = err;
+				err = NDM_TELNET_ERR_OK;
 			}
+		}
+	}
 
-			clear = true;
-			raw_sent = true;
-		} else if (strcmp(ndm_str_ptr(&str), NDM_TELNET_RAW_MODE "\r") == 0) {
-			if (!raw_sent) {
-				err = NDM_TELNET_ERR_WRONG_STATE;
-				goto error;
-			}
+	if (err == NDM_TELNET_ERR_AGAIN &&
+		ndm_telnet_deadline(telnet) >= 0 &&
+		__ndm_telnet_clock(telnet) >= telnet->io_deadline) {
+		err = NDM_TELNET_ERR_IO_TIMEOUT;
+	}
 
-			clear = true;
-			raw_recv = true;
-		}
+	return err;
+}
 
-		if (clear) {
-			ndm_str_clear(&str);
-		}
+enum ndm_telnet_err_t ndm_telnet_exec_batch(struct ndm_telnet_t *telnet,
+											const char *const *commands,
+											const size_t count,
+											const size_t window,
+											struct ndm_telnet_response_t *responses,
+											const unsigned int timeout)
+{
+	const size_t w = (window == 0) ? NDM_TELNET_DEF_BATCH_WINDOW : window;
+	enum ndm_telnet_err_t err = NDM_TELNET_ERR_OK;
+	size_t sent = 0;
+	size_t recvd = 0;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		responses[i].err = NDM_TELNET_ERR_OK;
+		responses[i].continued = false;
+		responses[i].code = 0;
+		responses[i].text = NULL;
+		responses[i].root = NULL;
 	}
 
-	while (true) {
-		char *p;
+	if (telnet->state != NDM_TELNET_STATE_READY || telnet->non_blocking) {
+		return NDM_TELNET_ERR_WRONG_CALL;
+	}
 
-		/* move read data to a buffer start */
-		if (t->buf_r == t->buf_w) {
-			t->buf_r = t->buf;
-			t->buf_w = t->buf;
-		} else {
-			const size_t shift = (size_t) (t->buf_r - t->buf);
+	/* do not send anything if one of commands is invalid */
+	for (i = 0; i < count; i++) {
+		err = ndm_telnet_check_command(commands[i]);
 
-			memmove(t->buf, t->buf_r, (size_t) (t->buf_w - t->buf_r));
-			t->buf_r -= shift;
-			t->buf_w -= shift;
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
 		}
+	}
 
-		if ((size_t) (t->buf_w - t->buf_r) >= NDM_TELNET_CONFIG_LEN &&
-			strncmp(t->buf_r, NDM_TELNET_CONFIG,
-					NDM_TELNET_CONFIG_LEN) == 0) {
-			err = NDM_TELNET_ERR_RAW_NOT_SUPPORTED;
-			goto error;
-		}
+	__ndm_telnet_shrink(telnet);
 
-		p = t->buf_r;
+	telnet->io_now = -1;
 
-		while (p < t->buf_w && *p != '\n') {
-			p++;
-		}
+	while (recvd < count) {
+		struct ndm_telnet_response_t *r = &responses[recvd];
 
-		if (p == t->buf_w) {
-			if (t->buf_w == t->buf_e) {
-				/* no ESC sequence or string without it */
-				err = NDM_TELNET_ERR_UNKNOWN_PROTOCOL;
-				goto error;
-			}
+		telnet->io_deadline = __ndm_telnet_clock(telnet) + timeout;
 
-			err = __ndm_telnet_fill(t);
+		while (sent < count && sent - recvd < w) {
+			err = __ndm_telnet_queue_cmd(telnet, commands[sent]);
 
 			if (err != NDM_TELNET_ERR_OK) {
-				goto error;
+				return err;
 			}
 
-			/* continue to fill the buffer */
-			continue;
-		}
-
-		/* a newline delimiter found */
-		char *s = t->buf_r;
-
-		while (s < p && isspace(*s)) {
-			s++;
+			sent++;
 		}
 
-		if (*s == '\n') {
-			t->buf_r = s + 1; /* skip an empty string */
-			continue;
-		}
+		/* send all queued commands at once */
+		err = __ndm_telnet_flush(telnet);
 
-		if ((size_t) (t->buf_w - s) < NDM_TELNET_RESPONSE_LEN ||
-			strncmp(s, NDM_TELNET_RESPONSE, NDM_TELNET_RESPONSE_LEN) != 0) {
-			err = NDM_TELNET_ERR_RAW_NOT_SUPPORTED;
-			goto error;
+		if (err != NDM_TELNET_ERR_OK) {
+			return err;
 		}
 
-		break;
-	}
+		do {
+			ndm_xml_doc_free(&r->root);
 
-	err = __ndm_telnet_recv(t, &continued, &response_code,
-							&response_text, &response);
+			err = __ndm_telnet_recv(telnet, NULL, &r->continued, &r->code,
+									&r->text, &r->root);
 
-	if (err != NDM_TELNET_ERR_OK) {
-		goto error;
-	}
+			if (err == NDM_TELNET_ERR_RESPONSE_FORMAT) {
+				/* the response was read completely, keep on up to
+				 * a final one of the command */
+				r->err = err;
+			} else if (err != NDM_TELNET_ERR_OK) {
+				return err;
+			}
+		} while (r->continued ||
+				 (r->root != NULL && strcmp(r->root->name, "event") == 0));
 
-	if (NDM_FAILED(response_code)) {
-		err = NDM_TELNET_ERR_RAW_FAILED;
+		recvd++;
 	}
 
-error:
-	if (err != NDM_TELNET_ERR_OK) {
-		ndm_telnet_close(&t);
-	}
+	return NDM_TELNET_ERR_OK;
+}
 
-	*telnet = t;
-	ndm_str_free(&str);
-	ndm_xml_doc_free(&response);
+void ndm_telnet_batch_free(struct ndm_telnet_response_t *responses,
+						   const size_t count)
+{
+	size_t i;
 
-	return err;
+	for (i = 0; i < count; i++) {
+		ndm_xml_doc_free(&responses[i].root);
+		responses[i].text = NULL;
+	}
 }
 
-enum ndm_telnet_err_t ndm_telnet_send(struct ndm_telnet_t *telnet,
-									  const char *const command,
-									  const unsigned int timeout)
+void ndm_telnet_close(struct ndm_telnet_t **telnet)
 {
-	const char *p = command;
+	size_t i;
 
-	while (isspace(*p)) {
-		p++;
+	if (telnet == NULL || *telnet == NULL) {
+		return;
 	}
 
-	if (*p == '\0') {
-		return NDM_TELNET_ERR_NO_COMMAND;
+	if ((*telnet)->stream != NULL) {
+		telnet_free((*telnet)->stream);
 	}
 
-	if (__ndm_telnet_has_lf(command)) {
-		return NDM_TELNET_ERR_COMMAND;
+	if ((*telnet)->sock >= 0) {
+		close((*telnet)->sock);
 	}
 
-	telnet->io_deadline = ndm_telnet_now() + timeout;
-
-	return __ndm_telnet_send_cmd(telnet, command);
-}
-
-
-enum ndm_telnet_err_t ndm_telnet_recv(struct ndm_telnet_t *telnet,
-									  bool *continued,
-									  ndm_code_t *response_code,
-									  const char **response_text,
-									  struct ndm_xml_elem_t **response,
-									  const unsigned int timeout)
-{
-	*continued = false;
-	*response_code = 0;
-	*response_text = NULL;
-	*response = NULL;
-
-	telnet->io_deadline = ndm_telnet_now() + timeout;
+	ndm_xml_dom_free(&(*telnet)->dom);
+	ndm_xml_filter_free(&(*telnet)->filter);
 
-	return __ndm_telnet_recv(telnet, continued, response_code,
-							 response_text, response);
-}
-
-void ndm_telnet_close(struct ndm_telnet_t **telnet)
-{
-	if (telnet == NULL || *telnet == NULL) {
-		return;
+	for (i = 0; i < NDM_TELNET_STATUS_QUERIES; i++) {
+		ndm_xml_query_free(&(*telnet)->status_queries[i]);
 	}
 
-	telnet_free((*telnet)->stream);
-	close((*telnet)->sock);
+	ndm_str_free(&(*telnet)->out);
+	ndm_str_free(&(*telnet)->user);
+	ndm_str_free(&(*telnet)->password);
+	__ndm_telnet_status_free(&(*telnet)->status);
+	ndm_buf_free(&(*telnet)->in);
 	free(*telnet);
 	*telnet = NULL;
 }
 
+void ndm_telnet_get_stats(const struct ndm_telnet_t *telnet,
+						  struct ndm_telnet_stats_t *stats)
+{
+	*stats = telnet->stats;
+}
+
 const char *ndm_telnet_strerror(const enum ndm_telnet_err_t err)
 {
 	switch (err) {
@@ -1106,6 +2545,18 @@ const char *ndm_telnet_strerror(const enum ndm_telnet_err_t err)
 			return "disconnected by peer";
 		}
 
+		case NDM_TELNET_ERR_BUFFER_SIZE: {
+			return "invalid buffer size";
+		}
+
+		case NDM_TELNET_ERR_AGAIN: {
+			return "operation would block";
+		}
+
+		case NDM_TELNET_ERR_WRONG_CALL: {
+			return "not allowed in the current session state";
+		}
+
 		default: {
 			break;
 		}
@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <string.h>
+#include <ndmtelnet/uring.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_EXT_ARG)
+#define NDM_URING_SUPPORTED
+#endif
+#endif /* __linux__ */
+
+#ifdef NDM_URING_SUPPORTED
+
+static inline int __ndm_uring_enter(struct ndm_uring_t *u,
+									const unsigned int min_complete,
+									const unsigned int flags,
+									void *arg,
+									const size_t arg_size)
+{
+	unsigned int submit;
+
+	__atomic_store_n(u->sq_tail, u->tail, __ATOMIC_RELEASE);
+	submit = u->tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+	return (int) syscall(__NR_io_uring_enter, u->fd, submit,
+						 min_complete, flags, arg, arg_size);
+}
+
+static struct io_uring_sqe *__ndm_uring_sqe(struct ndm_uring_t *u)
+{
+	struct io_uring_sqe *sqe;
+
+	if (u->tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >=
+		u->sq_entries) {
+		/* flush a full queue to the kernel */
+		if (__ndm_uring_enter(u, 0, 0, NULL, 0) < 0 ||
+			u->tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >=
+			u->sq_entries) {
+			return NULL;
+		}
+	}
+
+	sqe = (struct io_uring_sqe *) u->sqes + (u->tail & u->sq_mask);
+	memset(sqe, 0, sizeof(*sqe));
+	u->tail++;
+
+	return sqe;
+}
+
+bool ndm_uring_init(struct ndm_uring_t *u,
+					const unsigned int entries)
+{
+	struct io_uring_params p;
+	char *ring;
+	size_t sq_size;
+	size_t cq_size;
+	unsigned int *array;
+	unsigned int i;
+
+	memset(&p, 0, sizeof(p));
+	memset(u, 0, sizeof(*u));
+	u->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+
+	if (u->fd < 0) {
+		return false;
+	}
+
+	/* waits with a timeout need an extended argument */
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+		!(p.features & IORING_FEAT_EXT_ARG)) {
+		goto error;
+	}
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	u->ring_size = (sq_size > cq_size) ? sq_size : cq_size;
+	u->ring = mmap(NULL, u->ring_size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, u->fd, IORING_OFF_SQ_RING);
+
+	if (u->ring == MAP_FAILED) {
+		u->ring = NULL;
+		goto error;
+	}
+
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED, u->fd, IORING_OFF_SQES);
+
+	if (u->sqes == MAP_FAILED) {
+		u->sqes = NULL;
+		goto error;
+	}
+
+	ring = (char *) u->ring;
+	u->sq_head = (unsigned int *) (ring + p.sq_off.head);
+	u->sq_tail = (unsigned int *) (ring + p.sq_off.tail);
+	u->sq_mask = *(unsigned int *) (ring + p.sq_off.ring_mask);
+	u->sq_entries = p.sq_entries;
+	u->tail = *u->sq_tail;
+	u->cq_head = (unsigned int *) (ring + p.cq_off.head);
+	u->cq_tail = (unsigned int *) (ring + p.cq_off.tail);
+	u->cq_mask = *(unsigned int *) (ring + p.cq_off.ring_mask);
+	u->cqes = ring + p.cq_off.cqes;
+
+	/* submission entries are always taken in order */
+	array = (unsigned int *) (ring + p.sq_off.array);
+
+	for (i = 0; i < p.sq_entries; i++) {
+		array[i] = i;
+	}
+
+	return true;
+
+error:
+	ndm_uring_free(u);
+
+	return false;
+}
+
+void ndm_uring_free(struct ndm_uring_t *u)
+{
+	if (u->sqes != NULL) {
+		munmap(u->sqes, u->sqes_size);
+	}
+
+	if (u->ring != NULL) {
+		munmap(u->ring, u->ring_size);
+	}
+
+	if (u->fd >= 0) {
+		close(u->fd);
+	}
+
+	memset(u, 0, sizeof(*u));
+	u->fd = -1;
+}
+
+bool ndm_uring_recv(struct ndm_uring_t *u,
+					const int fd,
+					void *data,
+					const size_t size,
+					const uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = __ndm_uring_sqe(u);
+
+	if (sqe == NULL) {
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t) (uintptr_t) data;
+	sqe->len = (size > UINT32_MAX) ? UINT32_MAX : (uint32_t) size;
+	sqe->user_data = user_data;
+
+	return true;
+}
+
+bool ndm_uring_send(struct ndm_uring_t *u,
+					const int fd,
+					const void *data,
+					const size_t size,
+					const uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = __ndm_uring_sqe(u);
+
+	if (sqe == NULL) {
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t) (uintptr_t) data;
+	sqe->len = (size > UINT32_MAX) ? UINT32_MAX : (uint32_t) size;
+	sqe->user_data = user_data;
+
+	return true;
+}
+
+bool ndm_uring_poll(struct ndm_uring_t *u,
+					const int fd,
+					const unsigned int events,
+					const uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = __ndm_uring_sqe(u);
+
+	if (sqe == NULL) {
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	sqe->user_data = user_data;
+
+	return true;
+}
+
+bool ndm_uring_cancel(struct ndm_uring_t *u,
+					  const uint64_t target)
+{
+	struct io_uring_sqe *sqe = __ndm_uring_sqe(u);
+
+	if (sqe == NULL) {
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = target;
+	sqe->user_data = 0;
+
+	return true;
+}
+
+bool ndm_uring_wait(struct ndm_uring_t *u,
+					const int timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned int min_complete = 1;
+	unsigned int flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+
+	if (__atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE) != *u->cq_head) {
+		/* completions are ready, only submit new operations */
+		min_complete = 0;
+		flags = 0;
+	}
+
+	memset(&arg, 0, sizeof(arg));
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+	arg.ts = (uint64_t) (uintptr_t) &ts;
+
+	if (__ndm_uring_enter(u, min_complete, flags,
+						  (flags == 0) ? NULL : &arg,
+						  (flags == 0) ? 0 : sizeof(arg)) < 0) {
+		/* a timeout, a signal or a completion queue overflow */
+		return errno == ETIME || errno == EINTR || errno == EBUSY;
+	}
+
+	return true;
+}
+
+bool ndm_uring_peek(struct ndm_uring_t *u,
+					uint64_t *user_data,
+					int32_t *res)
+{
+	const unsigned int head = *u->cq_head;
+	const struct io_uring_cqe *cqe;
+
+	if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+
+	cqe = (const struct io_uring_cqe *) u->cqes + (head & u->cq_mask);
+	*user_data = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+#else /* NDM_URING_SUPPORTED */
+
+bool ndm_uring_init(struct ndm_uring_t *u,
+					const unsigned int entries)
+{
+	memset(u, 0, sizeof(*u));
+	u->fd = -1;
+
+	return false;
+}
+
+void ndm_uring_free(struct ndm_uring_t *u)
+{
+}
+
+bool ndm_uring_recv(struct ndm_uring_t *u,
+					const int fd,
+					void *data,
+					const size_t size,
+					const uint64_t user_data)
+{
+	return false;
+}
+
+bool ndm_uring_send(struct ndm_uring_t *u,
+					const int fd,
+					const void *data,
+					const size_t size,
+					const uint64_t user_data)
+{
+	return false;
+}
+
+bool ndm_uring_poll(struct ndm_uring_t *u,
+					const int fd,
+					const unsigned int events,
+					const uint64_t user_data)
+{
+	return false;
+}
+
+bool ndm_uring_cancel(struct ndm_uring_t *u,
+					  const uint64_t target)
+{
+	return false;
+}
+
+bool ndm_uring_wait(struct ndm_uring_t *u,
+					const int timeout)
+{
+	return false;
+}
+
+bool ndm_uring_peek(struct ndm_uring_t *u,
+					uint64_t *user_data,
+					int32_t *res)
+{
+	return false;
+}
+
+#endif /* NDM_URING_SUPPORTED */
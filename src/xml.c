@@ -4,15 +4,156 @@
 #include <stdbool.h>
 #include <ylib/list.h>
 #include <ylib/yxml.h>
+#include <ylib/yxml_run.h>
 #include <ndmtelnet/xml.h>
+#include <ndmtelnet/query.h>
 
-#define NDM_XML_VALUE_RESET_SIZE				1024
+#define NDM_XML_VALUE_KEEP_SIZE					65536
+#define NDM_XML_ARENA_ALIGN						sizeof(void *)
+
+struct ndm_xml_chunk_t {
+	struct ndm_xml_chunk_t *prev;
+	size_t size;
+};
+
+/* an open addressing table of first children with each name */
+struct ndm_xml_index_t {
+	size_t mask;
+	struct ndm_xml_elem_t *slots[1];
+};
+
+/* a document root is preceded by its own arena chunks if any */
+struct ndm_xml_doc_t {
+	struct ndm_xml_chunk_t *chunks;
+};
+
+static void __ndm_xml_chunks_free(struct ndm_xml_chunk_t *c)
+{
+	while (c != NULL) {
+		struct ndm_xml_chunk_t *prev = c->prev;
+
+		free(c);
+		c = prev;
+	}
+}
+
+void ndm_xml_arena_init(struct ndm_xml_arena_t *arena)
+{
+	arena->chunk = NULL;
+	arena->p = NULL;
+	arena->end = NULL;
+	arena->size = NDM_XML_ARENA_CHUNK_SIZE;
+}
+
+void ndm_xml_arena_reset(struct ndm_xml_arena_t *arena)
+{
+	struct ndm_xml_chunk_t *c = arena->chunk;
+
+	if (c == NULL) {
+		return;
+	}
+
+	/* the last chunk is the largest one */
+	__ndm_xml_chunks_free(c->prev);
+	c->prev = NULL;
+	arena->p = (char *) (c + 1);
+}
+
+void ndm_xml_arena_free(struct ndm_xml_arena_t *arena)
+{
+	__ndm_xml_chunks_free(arena->chunk);
+	ndm_xml_arena_init(arena);
+}
+
+static void *__ndm_xml_arena_alloc(struct ndm_xml_arena_t *arena,
+								   const size_t size,
+								   const size_t align)
+{
+	size_t pad = (size_t) (-(uintptr_t) arena->p & (align - 1));
+	char *p;
+
+	if (arena->p == NULL ||
+		pad + size > (size_t) (arena->end - arena->p)) {
+		size_t chunk_size = arena->size;
+		struct ndm_xml_chunk_t *c;
+
+		while (chunk_size < size + sizeof(*c)) {
+			chunk_size *= 2;
+		}
+
+		c = (struct ndm_xml_chunk_t *) malloc(chunk_size);
+
+		if (c == NULL) {
+			return NULL;
+		}
+
+		c->prev = arena->chunk;
+		c->size = chunk_size;
+		arena->chunk = c;
+		arena->p = (char *) (c + 1);
+		arena->end = (char *) c + chunk_size;
+		pad = 0;
+
+		/* grow chunks geometrically for large documents */
+		if (arena->size < NDM_XML_ARENA_MAX_CHUNK_SIZE) {
+			arena->size *= 2;
+		}
+	}
+
+	p = arena->p + pad;
+	arena->p = p + size;
+
+	return p;
+}
+
+/* releases last allocations from @a p if they are in a current chunk */
+static inline void __ndm_xml_arena_rewind(struct ndm_xml_arena_t *arena,
+										  void *p)
+{
+	char *q = (char *) p;
+
+	if (arena->chunk != NULL &&
+		q >= (char *) (arena->chunk + 1) && q <= arena->p) {
+		arena->p = q;
+	}
+}
+
+static inline struct ndm_xml_arena_t *
+__ndm_xml_dom_arena(struct ndm_xml_dom_t *dom)
+{
+	return (dom->arena == NULL) ? &dom->doc_arena : dom->arena;
+}
+
+static void __ndm_xml_dom_detach(struct ndm_xml_dom_t *dom)
+{
+	struct ndm_xml_arena_t *arena = &dom->doc_arena;
+	const struct ndm_xml_chunk_t *c = arena->chunk;
+	size_t used = 0;
+
+	/* a complete document takes its arena chunks away */
+	((struct ndm_xml_doc_t *) dom->root - 1)->chunks = arena->chunk;
+
+	while (c != NULL) {
+		used += c->size;
+		c = c->prev;
+	}
+
+	used -= (size_t) (arena->end - arena->p);
+	ndm_xml_arena_init(arena);
+
+	/* a next document is likely of the same size,
+	 * so it will be built in a single chunk */
+	while (arena->size < used &&
+		   arena->size < NDM_XML_ARENA_MAX_CHUNK_SIZE) {
+		arena->size *= 2;
+	}
+}
 
 static inline void __ndm_xml_value_init(struct ndm_xml_value_t *v)
 {
 	v->data = v->static_data;
 	v->size = 0;
-	v->cap = 0;
+	v->cap = sizeof(v->static_data);
 }
 
 static inline size_t __ndm_xml_value_cap(const size_t size,
@@ -22,15 +163,21 @@ static inline size_t __ndm_xml_value_cap(const size_t size,
 }
 
 static inline bool __ndm_xml_value_append(struct ndm_xml_value_t *v,
-										  const char* const value)
+										  const char *const value,
+										  const size_t value_size)
 {
-	const size_t value_size = strlen(value);
-
 	if (v->size + value_size > v->cap) {
-		const size_t cap = __ndm_xml_value_cap(v->size + value_size,
-											   NDM_XML_VALUE_ALLOC_STEP);
+		size_t cap = __ndm_xml_value_cap(v->size + value_size,
+										 NDM_XML_VALUE_ALLOC_STEP);
 		char *prev = (v->data == v->static_data) ? NULL : v->data;
-		char *data = (char *) realloc(prev, cap);
+		char *data;
+
+		/* grow geometrically for multi-megabyte values */
+		if (cap < 2 * v->cap) {
+			cap = 2 * v->cap;
+		}
+
+		data = (char *) realloc(prev, cap);
 
 		if (data == NULL) {
 			return false;
@@ -50,53 +197,602 @@ static inline bool __ndm_xml_value_append(struct ndm_xml_value_t *v,
 	return true;
 }
 
+static inline size_t __ndm_xml_token_len(const char *const token)
+{
+	size_t n = 1;
+
+	/* a parser returns a nonempty UTF-8 character at most */
+	while (token[n] != '\0') {
+		n++;
+	}
+
+	return n;
+}
+
+/* values of nested nodes are collected on top of their parent ones,
+ * so a value starts at its node @a start offset and is moved to an arena
+ * once when the node ends */
 static inline bool __ndm_xml_value_flush(struct ndm_xml_value_t *v,
-										 char **value)
+										 struct ndm_xml_arena_t *arena,
+										 const size_t start,
+										 char **value,
+										 size_t *value_len)
 {
-	const size_t value_size = (*value == NULL) ? 0 : strlen(*value);
-	char *val = (char *) realloc(*value, value_size + v->size + 1);
+	const size_t size = v->size - start;
+	char *val = (char *) __ndm_xml_arena_alloc(arena, size + 1, 1);
 
 	if (val == NULL) {
 		return false;
 	}
 
-	memcpy(val + value_size, v->data, v->size);
-	val[value_size + v->size] = 0;
+	memcpy(val, v->data + start, size);
+	val[size] = '\0';
 
 	*value = val;
+	*value_len = size;
+	v->size = start;
+
+	return true;
+}
+
+/* an empty value of a view */
+static char __ndm_xml_empty[1];
+
+/* a viewed value is a span of a pinned text copy, or a buffered one
+ * with a null @a value and its start offset in @a value_len */
+static inline bool __ndm_xml_value_unview(struct ndm_xml_value_t *v,
+										  char **value,
+										  size_t *value_len)
+{
+	const size_t start = v->size;
+
+	if (*value == NULL) {
+		return true;
+	}
 
-	/* reset a value data */
-	if (v->data != v->static_data && v->cap > NDM_XML_VALUE_RESET_SIZE) {
-		char *data = (char *) realloc(v->data, NDM_XML_VALUE_RESET_SIZE);
+	if (!__ndm_xml_value_append(v, *value, *value_len)) {
+		return false;
+	}
+
+	*value = NULL;
+	*value_len = start;
+
+	return true;
+}
+
+/* a @a view of @a data in a text copy extends a span adjacent to it,
+ * other data stop viewing a value */
+static inline bool __ndm_xml_value_add(struct ndm_xml_value_t *v,
+									   char **value,
+									   size_t *value_len,
+									   char *view,
+									   const char *const data,
+									   const size_t size)
+{
+	if (*value != NULL) {
+		if (view != NULL && *value_len == 0) {
+			*value = view;
+			*value_len = size;
 
-		if (data != NULL) {
-			v->data = data;
-			v->cap = NDM_XML_VALUE_RESET_SIZE;
+			return true;
+		}
+
+		if (view != NULL && *value + *value_len == view) {
+			*value_len += size;
+
+			return true;
+		}
+
+		if (!__ndm_xml_value_unview(v, value, value_len)) {
+			return false;
 		}
 	}
 
-	v->size = 0;
+	return __ndm_xml_value_append(v, data, size);
+}
+
+static inline bool __ndm_xml_value_end(struct ndm_xml_value_t *v,
+									   struct ndm_xml_arena_t *arena,
+									   char **value,
+									   size_t *value_len)
+{
+	if (*value == NULL) {
+		return __ndm_xml_value_flush(v, arena, *value_len, value, value_len);
+	}
+
+	/* a span is followed by markup or by a spare byte of a copy */
+	if (*value_len > 0) {
+		(*value)[*value_len] = '\0';
+	}
+
+	return true;
+}
+
+/* @b Returns a copy of a name ending at @a t if it is in @a text */
+static inline char *__ndm_xml_name_view(char *copy,
+										const char *const text,
+										const char *const t,
+										const size_t name_size)
+{
+	char *name;
+
+	if (copy == NULL || name_size > (size_t) (t - text)) {
+		return NULL;
+	}
+
+	/* a name terminator is not a part of any value */
+	name = copy + (t - text) - name_size;
+	name[name_size] = '\0';
+
+	return name;
+}
+
+/* a node name is a symbol, a view or null if it should be copied */
+static inline bool __ndm_xml_dom_name(struct ndm_xml_dom_t *dom,
+									  char *copy,
+									  const char *const text,
+									  const char *const t,
+									  const char *const name,
+									  const size_t name_size,
+									  const char **node_name)
+{
+	if (dom->symtab != NULL) {
+		*node_name = ndm_xml_symtab_intern(dom->symtab, name, name_size);
+
+		return *node_name != NULL;
+	}
+
+	*node_name = __ndm_xml_name_view(copy, text, t, name_size);
+
+	return true;
+}
+
+/* @b Returns a name copied right after its node */
+static inline const char *__ndm_xml_name_copy(void *node_end,
+											  const char *const name,
+											  const size_t name_size)
+{
+	char *copy = (char *) node_end;
+
+	memcpy(copy, name, name_size);
+	copy[name_size] = '\0';
+
+	return copy;
+}
+
+/* an open attribute or element value is collected */
+static inline bool __ndm_xml_dom_value_unview(struct ndm_xml_dom_t *dom)
+{
+	if (dom->a != NULL) {
+		return __ndm_xml_value_unview(&dom->value,
+									  &dom->a->value, &dom->a->value_len);
+	}
+
+	return __ndm_xml_value_unview(&dom->value,
+								  &dom->e->value, &dom->e->value_len);
+}
+
+/* @a data at @a t of @a text is viewed in its @a copy if any when
+ * it is the same as in text */
+static inline bool __ndm_xml_dom_value_add(struct ndm_xml_dom_t *dom,
+										   char *copy,
+										   const char *const text,
+										   const char *const t,
+										   const char *const data,
+										   const size_t size)
+{
+	char *view = NULL;
+
+	if (copy != NULL && (data == t || (size == 1 && *data == *t))) {
+		view = copy + (t - text);
+	}
+
+	if (dom->a != NULL) {
+		return __ndm_xml_value_add(&dom->value,
+								   &dom->a->value, &dom->a->value_len,
+								   view, data, size);
+	}
+
+	return __ndm_xml_value_add(&dom->value,
+							   &dom->e->value, &dom->e->value_len,
+							   view, data, size);
+}
+
+static inline size_t __ndm_xml_hash(const char *s, const size_t size)
+{
+	const char *end = s + size;
+	uint32_t h = 2166136261U;
+
+	/* FNV-1a */
+	while (s < end) {
+		h ^= (uint8_t) *s++;
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+static inline size_t __ndm_xml_name_hash(const char *name)
+{
+	return __ndm_xml_hash(name, strlen(name));
+}
+
+static inline size_t __ndm_xml_index_slot(struct ndm_xml_elem_t **slots,
+										  const size_t mask,
+										  const char *const name)
+{
+	size_t i = __ndm_xml_name_hash(name) & mask;
+
+	while (slots[i] != NULL && strcmp(slots[i]->name, name) != 0) {
+		i = (i + 1) & mask;
+	}
+
+	return i;
+}
+
+static inline size_t __ndm_xml_index_size(const size_t count)
+{
+	size_t size = 2;
+
+	/* a table is at most half full */
+	while (size < 2 * count) {
+		size *= 2;
+	}
+
+	return size;
+}
+
+/* links same named children of a wide @a elem and indexes first ones */
+static bool __ndm_xml_elem_index(struct ndm_xml_dom_t *dom,
+								 struct ndm_xml_arena_t *arena,
+								 struct ndm_xml_elem_t *elem)
+{
+	struct ndm_xml_elem_t *c = elem->children.head;
+	struct ndm_xml_elem_t **last;
+	struct ndm_xml_index_t *index;
+	size_t count = 0;
+	size_t names = 0;
+	size_t size;
+	size_t i;
+
+	while (c != NULL && count <= NDM_XML_INDEX_MIN_CHILDREN) {
+		c = c->next;
+		count++;
+	}
+
+	if (count <= NDM_XML_INDEX_MIN_CHILDREN) {
+		return true;
+	}
+
+	while (c != NULL) {
+		c = c->next;
+		count++;
+	}
+
+	size = __ndm_xml_index_size(count);
+
+	/* a build table is kept for next wide elements */
+	if (dom->index_size < size) {
+		last = (struct ndm_xml_elem_t **)
+			realloc(dom->index_buf, size * sizeof(*last));
+
+		if (last == NULL) {
+			return false;
+		}
+
+		dom->index_buf = last;
+		dom->index_size = size;
+	}
+
+	last = dom->index_buf;
+	memset(last, 0, size * sizeof(*last));
+
+	for (c = elem->children.head; c != NULL; c = c->next) {
+		i = __ndm_xml_index_slot(last, size - 1, c->name);
+
+		if (last[i] == NULL) {
+			names++;
+		} else {
+			last[i]->next_same = c;
+		}
+
+		last[i] = c;
+	}
+
+	size = __ndm_xml_index_size(names);
+	index = (struct ndm_xml_index_t *)
+		__ndm_xml_arena_alloc(arena,
+							  sizeof(*index) +
+							  (size - 1) * sizeof(index->slots[0]),
+							  NDM_XML_ARENA_ALIGN);
+
+	if (index == NULL) {
+		return false;
+	}
+
+	index->mask = size - 1;
+	memset(index->slots, 0, size * sizeof(index->slots[0]));
+
+	for (c = elem->children.head; c != NULL; c = c->next) {
+		i = __ndm_xml_index_slot(index->slots, index->mask, c->name);
+
+		if (index->slots[i] == NULL) {
+			index->slots[i] = c;
+		}
+	}
+
+	elem->index = index;
+
+	return true;
+}
+
+/* names most NDM responses consist of */
+static const char *const NDM_XML_SYMBOLS[] = {
+	"response", "event", "message", "error", "prompt", "continued",
+	"code", "warning", "critical", "ident", "source", "class",
+	"interface", "name", "id", "index", "type", "description", "state",
+	"link", "connected", "mtu", "address", "mask", "mac", "uptime",
+	"host", "hostname", "ip", "route", "destination", "gateway",
+	"metric", "flags", "active", "priority", "security-level",
+	"global", "role", "port", "enabled", "value", "status"
+};
+
+#define NDM_XML_SYMTAB_MIN_SIZE					128
+
+static inline size_t __ndm_xml_symtab_slot(const char **slots,
+										   const size_t mask,
+										   const char *const name,
+										   const size_t name_len)
+{
+	size_t i = __ndm_xml_hash(name, name_len) & mask;
+
+	while (slots[i] != NULL &&
+		   (strncmp(slots[i], name, name_len) != 0 ||
+			slots[i][name_len] != '\0')) {
+		i = (i + 1) & mask;
+	}
+
+	return i;
+}
+
+static bool __ndm_xml_symtab_grow(struct ndm_xml_symtab_t *symtab)
+{
+	const size_t size = (symtab->size == 0) ?
+		NDM_XML_SYMTAB_MIN_SIZE : 2 * symtab->size;
+	const char **slots = (const char **) calloc(size, sizeof(*slots));
+	size_t i;
+
+	if (slots == NULL) {
+		return false;
+	}
+
+	for (i = 0; i < symtab->size; i++) {
+		const char *sym = symtab->slots[i];
+
+		if (sym != NULL) {
+			slots[__ndm_xml_symtab_slot(slots, size - 1,
+										sym, strlen(sym))] = sym;
+		}
+	}
+
+	free(symtab->slots);
+	symtab->slots = slots;
+	symtab->size = size;
+
+	return true;
+}
+
+/* a table is seeded with static names on its first use */
+static bool __ndm_xml_symtab_seed(struct ndm_xml_symtab_t *symtab)
+{
+	size_t i;
+
+	if (symtab->slots != NULL) {
+		return true;
+	}
+
+	if (!__ndm_xml_symtab_grow(symtab)) {
+		return false;
+	}
+
+	for (i = 0; i < sizeof(NDM_XML_SYMBOLS) / sizeof(NDM_XML_SYMBOLS[0]);
+		 i++) {
+		const char *sym = NDM_XML_SYMBOLS[i];
+
+		symtab->slots[__ndm_xml_symtab_slot(symtab->slots,
+											symtab->size - 1,
+											sym, strlen(sym))] = sym;
+		symtab->count++;
+	}
 
 	return true;
 }
 
+void ndm_xml_symtab_init(struct ndm_xml_symtab_t *symtab)
+{
+	symtab->slots = NULL;
+	symtab->size = 0;
+	symtab->count = 0;
+	ndm_xml_arena_init(&symtab->names);
+}
+
+void ndm_xml_symtab_free(struct ndm_xml_symtab_t *symtab)
+{
+	free(symtab->slots);
+	ndm_xml_arena_free(&symtab->names);
+	ndm_xml_symtab_init(symtab);
+}
+
+const char *ndm_xml_symtab_intern(struct ndm_xml_symtab_t *symtab,
+								  const char *const name,
+								  const size_t name_len)
+{
+	size_t i;
+	char *sym;
+
+	if (!__ndm_xml_symtab_seed(symtab)) {
+		return NULL;
+	}
+
+	i = __ndm_xml_symtab_slot(symtab->slots, symtab->size - 1,
+							  name, name_len);
+
+	if (symtab->slots[i] != NULL) {
+		return symtab->slots[i];
+	}
+
+	/* a table is at most half full */
+	if (2 * (symtab->count + 1) > symtab->size) {
+		if (!__ndm_xml_symtab_grow(symtab)) {
+			return NULL;
+		}
+
+		i = __ndm_xml_symtab_slot(symtab->slots, symtab->size - 1,
+								  name, name_len);
+	}
+
+	sym = (char *) __ndm_xml_arena_alloc(&symtab->names, name_len + 1, 1);
+
+	if (sym == NULL) {
+		return NULL;
+	}
+
+	memcpy(sym, name, name_len);
+	sym[name_len] = '\0';
+
+	symtab->slots[i] = sym;
+	symtab->count++;
+
+	return sym;
+}
+
+const char *ndm_xml_symtab_find(struct ndm_xml_symtab_t *symtab,
+								const char *const name)
+{
+	if (!__ndm_xml_symtab_seed(symtab)) {
+		return NULL;
+	}
+
+	return symtab->slots[__ndm_xml_symtab_slot(symtab->slots,
+											   symtab->size - 1,
+											   name, strlen(name))];
+}
+
 static inline void __ndm_xml_value_free(struct ndm_xml_value_t *v)
 {
 	if (v->data != v->static_data) {
 		free(v->data);
-		v->size = 0;
-		v->cap = 0;
 	}
+
+	__ndm_xml_value_init(v);
+}
+
+static inline void __ndm_xml_value_reset(struct ndm_xml_value_t *v)
+{
+	/* a grown buffer is kept for next documents unless it is huge */
+	if (v->cap > NDM_XML_VALUE_KEEP_SIZE) {
+		__ndm_xml_value_free(v);
+	}
+
+	v->size = 0;
 }
 
 void ndm_xml_dom_init(struct ndm_xml_dom_t *dom)
+{
+	ndm_xml_dom_init_ex(dom, NULL);
+}
+
+void ndm_xml_dom_init_ex(struct ndm_xml_dom_t *dom,
+						 struct ndm_xml_arena_t *arena)
 {
 	yxml_init(&dom->parser, dom->parser_buf, sizeof(dom->parser_buf));
 	dom->root = NULL;
 	dom->e = NULL;
 	dom->a = NULL;
 	__ndm_xml_value_init(&dom->value);
-};
+	ndm_xml_arena_init(&dom->doc_arena);
+	dom->arena = arena;
+	dom->depth = 0;
+	dom->skip = 0;
+	dom->flags = 0;
+	dom->index_buf = NULL;
+	dom->index_size = 0;
+	dom->symtab = NULL;
+	dom->filter = NULL;
+	dom->check = NULL;
+	dom->dropped = 0;
+	dom->end_fn = NULL;
+	dom->end_data = NULL;
+}
+
+void ndm_xml_dom_set_symtab(struct ndm_xml_dom_t *dom,
+							struct ndm_xml_symtab_t *symtab)
+{
+	dom->symtab = symtab;
+}
+
+void ndm_xml_dom_set_filter(struct ndm_xml_dom_t *dom,
+							struct ndm_xml_filter_t *filter)
+{
+	dom->filter = filter;
+}
+
+void ndm_xml_dom_set_end_fn(struct ndm_xml_dom_t *dom,
+							ndm_xml_dom_end_fn_t fn,
+							void *data)
+{
+	dom->end_fn = fn;
+	dom->end_data = data;
+}
+
+void ndm_xml_dom_set_flags(struct ndm_xml_dom_t *dom,
+						   const unsigned int flags)
+{
+	dom->flags = flags;
+}
+
+void ndm_xml_dom_reset(struct ndm_xml_dom_t *dom)
+{
+	yxml_init(&dom->parser, dom->parser_buf, sizeof(dom->parser_buf));
+	dom->root = NULL;
+	dom->e = NULL;
+	dom->a = NULL;
+	dom->depth = 0;
+	dom->skip = 0;
+	dom->check = NULL;
+	dom->dropped = 0;
+	__ndm_xml_value_reset(&dom->value);
+
+	/* drop an incomplete document keeping a chunk for a next one */
+	ndm_xml_arena_reset(&dom->doc_arena);
+}
+
+/* an element is unlinked if its attributes do not match a filter,
+ * its nodes are parsed up to its end without building them */
+static void __ndm_xml_dom_check(struct ndm_xml_dom_t *dom,
+								struct ndm_xml_arena_t *arena)
+{
+	struct ndm_xml_elem_t *e = dom->check;
+
+	if (e == NULL) {
+		return;
+	}
+
+	dom->check = NULL;
+
+	if (ndm_xml_filter_attrs_end(dom->filter, e)) {
+		return;
+	}
+
+	list_remove(e->parent->children, e);
+	dom->e = e->parent;
+	dom->dropped = 1;
+
+	/* a view copy of a next text part may follow attributes */
+	if (!(dom->flags & NDM_XML_DOM_FLAG_VIEWS)) {
+		__ndm_xml_arena_rewind(arena, e);
+	}
+}
 
 enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 									 const size_t text_size,
@@ -107,11 +803,52 @@ enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 	const char *t = text;
 	const char *tend = text + text_size;
 	yxml_t *p = &dom->parser;
+	struct ndm_xml_arena_t *arena = __ndm_xml_dom_arena(dom);
 	enum ndm_xml_err_t err = NDM_XML_ERR_OK;
+	char *copy = NULL;
+
+	*root = NULL;
+
+	if ((dom->flags & NDM_XML_DOM_FLAG_VIEWS) && text_size > 0) {
+		/* a document keeps text it is parsed from with a spare byte
+		 * to terminate a last span */
+		copy = (char *) __ndm_xml_arena_alloc(arena, text_size + 1, 1);
+
+		if (copy == NULL) {
+			err = NDM_XML_ERR_NOMEM;
+			goto stop;
+		}
 
-	*root = NULL;
+		memcpy(copy, text, text_size);
+	}
 
 	while (t < tend) {
+		size_t run;
+
+		/* copy plain content and attribute values in bulk */
+		if (yxml_run(p, t, (size_t) (tend - t), &run) != YXML_OK) {
+			if (dom->a == NULL) {
+				__ndm_xml_dom_check(dom, arena);
+			}
+
+			if (dom->dropped == 0 &&
+				!__ndm_xml_dom_value_add(dom, copy, text, t, t, run)) {
+				err = NDM_XML_ERR_NOMEM;
+				goto stop;
+			}
+
+			t += run;
+
+			continue;
+		}
+
+		/* a reference is decoded into a value buffer */
+		if (copy != NULL && *t == '&' && dom->e != NULL &&
+			dom->dropped == 0 && !__ndm_xml_dom_value_unview(dom)) {
+			err = NDM_XML_ERR_NOMEM;
+			goto stop;
+		}
+
 		switch (yxml_parse(p, *t)) {
 			case YXML_EEOF: {
 				err = NDM_XML_ERR_EOF;
@@ -144,34 +881,80 @@ enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 
 			case YXML_ELEMSTART: {
 				const size_t name_size = yxml_symlen(p, p->elem);
+				const char *name = NULL;
 				size_t elem_size;
 				struct ndm_xml_elem_t *e;
 
-				if (dom->e != NULL &&
-					!__ndm_xml_value_flush(&dom->value,
-										   &dom->e->value)) {
-					err = NDM_XML_ERR_NOMEM;
-					goto stop;
+				__ndm_xml_dom_check(dom, arena);
+
+				if (dom->dropped > 0) {
+					dom->dropped++;
+					break;
 				}
 
-				elem_size = sizeof(*e) + name_size;
-				e = (struct ndm_xml_elem_t *) malloc(elem_size);
+				if (dom->filter != NULL) {
+					if (dom->root == NULL) {
+						ndm_xml_filter_reset(dom->filter);
+					}
 
-				if (e == NULL) {
+					if (!ndm_xml_filter_start(dom->filter, p->elem)) {
+						dom->dropped = 1;
+						break;
+					}
+				}
+
+				if (!__ndm_xml_dom_name(dom, copy, text, t,
+										p->elem, name_size, &name)) {
 					err = NDM_XML_ERR_NOMEM;
 					goto stop;
 				}
 
-				memcpy(e->name, p->elem, name_size);
-				e->name[name_size] = 0;
+				elem_size = sizeof(*e) + ((name == NULL) ? name_size + 1 : 0);
+
+				if (dom->root == NULL) {
+					struct ndm_xml_doc_t *doc = (struct ndm_xml_doc_t *)
+						__ndm_xml_arena_alloc(arena,
+											  sizeof(*doc) + elem_size,
+											  NDM_XML_ARENA_ALIGN);
+
+					if (doc == NULL) {
+						err = NDM_XML_ERR_NOMEM;
+						goto stop;
+					}
+
+					doc->chunks = NULL;
+					e = (struct ndm_xml_elem_t *) (doc + 1);
+				} else {
+					e = (struct ndm_xml_elem_t *)
+						__ndm_xml_arena_alloc(arena, elem_size,
+											  NDM_XML_ARENA_ALIGN);
+
+					if (e == NULL) {
+						err = NDM_XML_ERR_NOMEM;
+						goto stop;
+					}
+				}
+
+				e->name = (name == NULL) ?
+					__ndm_xml_name_copy(e + 1, p->elem, name_size) : name;
+
+				/* an open element keeps its value offset or span */
+				if (copy != NULL) {
+					e->value = __ndm_xml_empty;
+					e->value_len = 0;
+				} else {
+					e->value = NULL;
+					e->value_len = dom->value.size;
+				}
 
-				e->value = NULL;
 				e->attributes.head = NULL;
 				e->attributes.tail = NULL;
 				e->children.head = NULL;
 				e->children.tail = NULL;
 				e->next = NULL;
 				e->prev = NULL;
+				e->next_same = NULL;
+				e->index = NULL;
 
 				if (dom->root == NULL) {
 					dom->root = e;
@@ -182,12 +965,25 @@ enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 				e->parent = dom->e;
 				dom->e = e;
 
+				if (dom->filter != NULL) {
+					dom->check = e;
+				}
+
 				break;
 			}
 
 			case YXML_CONTENT:
 			case YXML_ATTRVAL: {
-				if (!__ndm_xml_value_append(&dom->value, p->data)) {
+				if (dom->a == NULL) {
+					__ndm_xml_dom_check(dom, arena);
+				}
+
+				if (dom->dropped > 0) {
+					break;
+				}
+
+				if (!__ndm_xml_dom_value_add(dom, copy, text, t, p->data,
+											 __ndm_xml_token_len(p->data))) {
 					err = NDM_XML_ERR_NOMEM;
 					goto stop;
 				}
@@ -196,14 +992,38 @@ enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 			}
 
 			case YXML_ELEMEND: {
-				if (!__ndm_xml_value_flush(&dom->value, &dom->e->value)) {
+				__ndm_xml_dom_check(dom, arena);
+
+				if (dom->dropped > 0) {
+					dom->dropped--;
+					break;
+				}
+
+				if (dom->filter != NULL) {
+					ndm_xml_filter_end(dom->filter);
+				}
+
+				if (!__ndm_xml_value_end(&dom->value, arena,
+										 &dom->e->value,
+										 &dom->e->value_len) ||
+					!__ndm_xml_elem_index(dom, arena, dom->e)) {
 					err = NDM_XML_ERR_NOMEM;
 					goto stop;
 				}
 
+				if (dom->end_fn != NULL) {
+					dom->end_fn(dom->e, dom->end_data);
+				}
+
 				if (dom->e->parent == NULL) {
+					if (dom->arena == NULL) {
+						__ndm_xml_dom_detach(dom);
+					}
+
 					*root = dom->root;
-					dom->root = NULL;
+
+					/* a parser is ready for a next document */
+					ndm_xml_dom_reset(dom);
 
 					t++;
 
@@ -218,20 +1038,41 @@ enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 
 			case YXML_ATTRSTART: {
 				const size_t name_size = yxml_symlen(p, p->attr);
+				const char *name = NULL;
 				struct ndm_xml_attr_t *a;
-				const size_t attr_size = sizeof(*a) + name_size;
+				size_t attr_size;
+
+				if (dom->dropped > 0) {
+					break;
+				}
+
+				if (!__ndm_xml_dom_name(dom, copy, text, t,
+										p->attr, name_size, &name)) {
+					err = NDM_XML_ERR_NOMEM;
+					goto stop;
+				}
 
-				a = (struct ndm_xml_attr_t *) malloc(attr_size);
+				attr_size = sizeof(*a) + ((name == NULL) ? name_size + 1 : 0);
+				a = (struct ndm_xml_attr_t *)
+					__ndm_xml_arena_alloc(arena, attr_size,
+										  NDM_XML_ARENA_ALIGN);
 
 				if (a == NULL) {
 					err = NDM_XML_ERR_NOMEM;
 					goto stop;
 				}
 
-				memcpy(a->name, p->attr, name_size);
-				a->name[name_size] = 0;
+				a->name = (name == NULL) ?
+					__ndm_xml_name_copy(a + 1, p->attr, name_size) : name;
+
+				if (copy != NULL) {
+					a->value = __ndm_xml_empty;
+					a->value_len = 0;
+				} else {
+					a->value = NULL;
+					a->value_len = dom->value.size;
+				}
 
-				a->value = NULL;
 				a->next = NULL;
 				a->prev = NULL;
 
@@ -242,7 +1083,13 @@ enum ndm_xml_err_t ndm_xml_dom_parse(const char *const text,
 			}
 
 			case YXML_ATTREND: {
-				if (!__ndm_xml_value_flush(&dom->value, &dom->a->value)) {
+				if (dom->dropped > 0) {
+					break;
+				}
+
+				if (!__ndm_xml_value_end(&dom->value, arena,
+										 &dom->a->value,
+										 &dom->a->value_len)) {
 					err = NDM_XML_ERR_NOMEM;
 					goto stop;
 				}
@@ -274,57 +1121,291 @@ stop:
 	return err;
 }
 
-void ndm_xml_dom_free(struct ndm_xml_dom_t *dom)
+static inline void __ndm_xml_token_set(struct ndm_xml_token_t *token,
+									   const enum ndm_xml_token_type_t type,
+									   const char *name,
+									   const char *value,
+									   const size_t value_len,
+									   const size_t depth)
 {
-	ndm_xml_doc_free(&dom->root);
-	__ndm_xml_value_free(&dom->value);
+	token->type = type;
+	token->name = name;
+	token->value = value;
+	token->value_len = value_len;
+	token->depth = depth;
 }
 
-void ndm_xml_doc_free(struct ndm_xml_elem_t **root)
+enum ndm_xml_err_t ndm_xml_cursor_next(const char *const text,
+									   const size_t text_size,
+									   struct ndm_xml_dom_t *dom,
+									   size_t *parsed_size,
+									   struct ndm_xml_token_t *token)
 {
-	struct ndm_xml_elem_t *e;
-	struct ndm_xml_elem_t *parent = NULL;
+	const char *t = text;
+	const char *tend = text + text_size;
+	yxml_t *p = &dom->parser;
+	enum ndm_xml_err_t err = NDM_XML_ERR_OK;
 
-	if (root == NULL) {
-		return;
-	}
+	__ndm_xml_token_set(token, NDM_XML_TOKEN_NONE, NULL, NULL, 0, 0);
 
-	e = *root;
+	while (t < tend && token->type == NDM_XML_TOKEN_NONE) {
+		size_t run;
+		const yxml_ret_t ret = yxml_run(p, t, (size_t) (tend - t), &run);
 
-	while (e != NULL) {
-		struct ndm_xml_elem_t *r;
+		/* pass plain content straight from the text */
+		if (ret == YXML_CONTENT) {
+			if (dom->skip == 0) {
+				__ndm_xml_token_set(token, NDM_XML_TOKEN_CONTENT, NULL,
+									t, run, dom->depth - 1);
+			}
+
+			t += run;
 
-		while (e->children.head != NULL) {
-			parent = e;
-			e = e->children.head;
+			continue;
 		}
 
-		r = e;
+		if (ret == YXML_ATTRVAL) {
+			if (dom->skip == 0 &&
+				!__ndm_xml_value_append(&dom->value, t, run)) {
+				err = NDM_XML_ERR_NOMEM;
+				goto stop;
+			}
 
-		if (r->next != NULL) {
-			e = e->next;
-			list_remove(r->parent->children, r);
-		} else {
-			e = parent;
+			t += run;
+
+			continue;
+		}
+
+		switch (yxml_parse(p, *t)) {
+			case YXML_OK:
+			case YXML_ATTRSTART: {
+				break;
+			}
+
+			case YXML_ELEMSTART: {
+				if (dom->skip == 0) {
+					__ndm_xml_token_set(token, NDM_XML_TOKEN_ELEM_START,
+										p->elem, NULL, 0, dom->depth);
+				}
+
+				dom->depth++;
+
+				break;
+			}
+
+			case YXML_CONTENT: {
+				if (dom->skip == 0) {
+					__ndm_xml_token_set(token, NDM_XML_TOKEN_CONTENT, NULL,
+										p->data, __ndm_xml_token_len(p->data),
+										dom->depth - 1);
+				}
+
+				break;
+			}
+
+			case YXML_ATTRVAL: {
+				if (dom->skip == 0 &&
+					!__ndm_xml_value_append(&dom->value, p->data,
+											__ndm_xml_token_len(p->data))) {
+					err = NDM_XML_ERR_NOMEM;
+					goto stop;
+				}
+
+				break;
+			}
+
+			case YXML_ATTREND: {
+				const size_t value_len = dom->value.size;
+
+				if (dom->skip == 0) {
+					if (!__ndm_xml_value_append(&dom->value, "", 1)) {
+						err = NDM_XML_ERR_NOMEM;
+						goto stop;
+					}
+
+					__ndm_xml_token_set(token, NDM_XML_TOKEN_ATTR, p->attr,
+										dom->value.data, value_len,
+										dom->depth - 1);
+				}
+
+				/* a value stays in place until a next attribute */
+				dom->value.size = 0;
+
+				break;
+			}
+
+			case YXML_ELEMEND: {
+				dom->depth--;
+
+				if (dom->skip > dom->depth) {
+					/* a skipped element ends */
+					dom->skip = 0;
+				}
+
+				if (dom->skip == 0) {
+					/* a closed name still follows its parent one on a stack */
+					__ndm_xml_token_set(token, NDM_XML_TOKEN_ELEM_END,
+										(const char *) p->stack +
+											p->stacklen + 1,
+										NULL, 0, dom->depth);
+				}
+
+				if (dom->depth == 0) {
+					/* a parser is ready for a next document,
+					 * yxml_init() keeps a closed name in place */
+					ndm_xml_dom_reset(dom);
+				}
+
+				break;
+			}
+
+			case YXML_EEOF: {
+				err = NDM_XML_ERR_EOF;
+				goto stop;
+			}
+
+			case YXML_EREF: {
+				err = NDM_XML_ERR_REF;
+				goto stop;
+			}
+
+			case YXML_ECLOSE: {
+				err = NDM_XML_ERR_CLOSE;
+				goto stop;
+			}
+
+			case YXML_ESTACK:
+			case YXML_ESYN: {
+				err = NDM_XML_ERR_SYNTAX;
+				goto stop;
+			}
+
+			case YXML_PISTART:
+			case YXML_PICONTENT:
+			case YXML_PIEND: {
+				err = NDM_XML_ERR_PI;
+				goto stop;
+			}
 
-			if (parent != NULL) {
-				list_remove(r->parent->children, r);
-				parent = e->parent;
+			default: {
+				err = NDM_XML_ERR_INTERNAL;
+				goto stop;
 			}
 		}
 
-		while (r->attributes.head != NULL) {
-			struct ndm_xml_attr_t *a = r->attributes.head;
+		t++;
+	}
+
+stop:
+	*parsed_size = (size_t) (t - text);
+
+	return err;
+}
+
+void ndm_xml_cursor_skip(struct ndm_xml_dom_t *dom)
+{
+	dom->skip = dom->depth;
+}
+
+enum ndm_xml_err_t ndm_xml_sax_parse(const char *const text,
+									 const size_t text_size,
+									 struct ndm_xml_dom_t *dom,
+									 const struct ndm_xml_sax_t *sax,
+									 void *data,
+									 size_t *parsed_size,
+									 bool *done)
+{
+	size_t parsed = 0;
+	enum ndm_xml_err_t err = NDM_XML_ERR_OK;
+
+	*done = false;
+
+	while (!*done && parsed < text_size && err == NDM_XML_ERR_OK) {
+		struct ndm_xml_token_t token;
+		size_t size = 0;
+
+		err = ndm_xml_cursor_next(text + parsed, text_size - parsed,
+								  dom, &size, &token);
+		parsed += size;
+
+		if (err != NDM_XML_ERR_OK) {
+			break;
+		}
+
+		switch (token.type) {
+			case NDM_XML_TOKEN_NONE: {
+				break;
+			}
+
+			case NDM_XML_TOKEN_ELEM_START: {
+				if (sax->elem_start != NULL) {
+					sax->elem_start(token.name, token.depth, data);
+				}
+
+				break;
+			}
+
+			case NDM_XML_TOKEN_ATTR: {
+				if (sax->attr != NULL) {
+					sax->attr(token.name, token.value, token.value_len,
+							  token.depth, data);
+				}
+
+				break;
+			}
+
+			case NDM_XML_TOKEN_CONTENT: {
+				if (sax->content != NULL) {
+					sax->content(token.value, token.value_len,
+								 token.depth, data);
+				}
+
+				break;
+			}
+
+			case NDM_XML_TOKEN_ELEM_END: {
+				if (sax->elem_end != NULL) {
+					sax->elem_end(token.name, token.depth, data);
+				}
+
+				*done = (token.depth == 0);
+
+				break;
+			}
 
-			list_remove(r->attributes, a);
-			free(a->value);
-			free(a);
+			default: {
+				err = NDM_XML_ERR_INTERNAL;
+				break;
+			}
 		}
+	}
+
+	*parsed_size = parsed;
+
+	return err;
+}
+
+void ndm_xml_dom_free(struct ndm_xml_dom_t *dom)
+{
+	/* an incomplete document is in a document arena */
+	ndm_xml_arena_free(&dom->doc_arena);
+	dom->root = NULL;
+	dom->e = NULL;
+	dom->a = NULL;
+	__ndm_xml_value_free(&dom->value);
+	free(dom->index_buf);
+	dom->index_buf = NULL;
+	dom->index_size = 0;
+}
 
-		free(r->value);
-		free(r);
+void ndm_xml_doc_free(struct ndm_xml_elem_t **root)
+{
+	if (root == NULL || *root == NULL) {
+		return;
 	}
 
+	/* nodes of a caller arena document are released with the arena */
+	__ndm_xml_chunks_free(((struct ndm_xml_doc_t *) *root - 1)->chunks);
 	*root = NULL;
 }
 
@@ -349,6 +1430,13 @@ struct ndm_xml_elem_t *
 ndm_xml_elem_find_child(const struct ndm_xml_elem_t *const elem,
 						const char *const name)
 {
+	struct ndm_xml_index_t *index = elem->index;
+
+	if (index != NULL) {
+		return index->slots[
+			__ndm_xml_index_slot(index->slots, index->mask, name)];
+	}
+
 	return __ndm_xml_elem_find(elem->children.head, name);
 }
 
@@ -356,9 +1444,24 @@ struct ndm_xml_elem_t *
 ndm_xml_elem_find_next(const struct ndm_xml_elem_t *const elem,
 					   const char *const name)
 {
+	if (elem->parent != NULL && elem->parent->index != NULL &&
+		strcmp(elem->name, name) == 0) {
+		return elem->next_same;
+	}
+
 	return __ndm_xml_elem_find(elem->next, name);
 }
 
+struct ndm_xml_elem_t *
+ndm_xml_elem_find_next_same(const struct ndm_xml_elem_t *const elem)
+{
+	if (elem->parent != NULL && elem->parent->index != NULL) {
+		return elem->next_same;
+	}
+
+	return __ndm_xml_elem_find(elem->next, elem->name);
+}
+
 struct ndm_xml_attr_t *
 ndm_xml_elem_find_attr(const struct ndm_xml_elem_t *const elem,
 					   const char *const name)
@@ -375,3 +1478,60 @@ ndm_xml_elem_find_attr(const struct ndm_xml_elem_t *const elem,
 
 	return NULL;
 }
+
+struct ndm_xml_elem_t *
+ndm_xml_elem_find_child_sym(const struct ndm_xml_elem_t *const elem,
+							const char *const sym)
+{
+	struct ndm_xml_elem_t *e = elem->children.head;
+
+	if (elem->index != NULL) {
+		return ndm_xml_elem_find_child(elem, sym);
+	}
+
+	while (e != NULL && e->name != sym) {
+		e = e->next;
+	}
+
+	return e;
+}
+
+struct ndm_xml_elem_t *
+ndm_xml_elem_find_next_sym(const struct ndm_xml_elem_t *const elem,
+						   const char *const sym)
+{
+	struct ndm_xml_elem_t *e = elem->next;
+
+	if (elem->name == sym) {
+		return ndm_xml_elem_find_next_same(elem);
+	}
+
+	while (e != NULL && e->name != sym) {
+		e = e->next;
+	}
+
+	return e;
+}
+
+struct ndm_xml_attr_t *
+ndm_xml_elem_find_attr_sym(const struct ndm_xml_elem_t *const elem,
+						   const char *const sym)
+{
+	struct ndm_xml_attr_t *a = elem->attributes.head;
+
+	while (a != NULL && a->name != sym) {
+		a = a->next;
+	}
+
+	return a;
+}
+
+size_t ndm_xml_elem_value_len(const struct ndm_xml_elem_t *const elem)
+{
+	return elem->value_len;
+}
+
+size_t ndm_xml_attr_value_len(const struct ndm_xml_attr_t *const attr)
+{
+	return attr->value_len;
+}
@@ -0,0 +1,110 @@
+/* kernels are static, so they are checked from their own translation unit */
+#include "../src/scan.c"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define NDM_SCAN_CHECK_LEN						64
+#define NDM_SCAN_CHECK_ROUNDS					64
+
+struct ndm_scan_check_t {
+	ndm_scan_fn_t fn;
+	const char *name;
+};
+
+static const struct ndm_scan_check_t NDM_SCAN_CHECKS[] = {
+#ifdef NDM_SCAN_HAS_SSE2
+	{__ndm_scan_sse2, "sse2"},
+#endif
+#ifdef NDM_SCAN_HAS_AVX2
+	{__ndm_scan_avx2, "avx2"},
+#endif
+#ifdef NDM_SCAN_HAS_NEON
+	{__ndm_scan_neon, "neon"},
+#endif
+	{__ndm_scan_scalar, "scalar"}
+};
+
+static bool __ndm_scan_check_supported(const struct ndm_scan_check_t *c)
+{
+#ifdef NDM_SCAN_HAS_AVX2
+	if (c->fn == __ndm_scan_avx2) {
+		__builtin_cpu_init();
+
+		return __builtin_cpu_supports("avx2") != 0;
+	}
+#endif
+
+	(void) c;
+
+	return true;
+}
+
+static unsigned char __ndm_scan_check_byte(void)
+{
+	/* a small alphabet makes both hits and misses frequent */
+	return (unsigned char) ((rand() % 2 == 0) ?
+		rand() % 8 : rand() % 256);
+}
+
+int main(void)
+{
+	/* bytes past an end may be special too to catch overreads */
+	char buf[2 * NDM_SCAN_CHECK_LEN + 32];
+	struct ndm_scan_set_t set;
+	size_t k, round, off, len, i;
+	unsigned long failed = 0;
+	unsigned long checked = 0;
+	unsigned long kernel_failed;
+
+	srand(1);
+
+	for (k = 0; k < sizeof(NDM_SCAN_CHECKS) / sizeof(NDM_SCAN_CHECKS[0]); k++) {
+		const struct ndm_scan_check_t *c = &NDM_SCAN_CHECKS[k];
+
+		if (!__ndm_scan_check_supported(c)) {
+			printf("%s: not supported\n", c->name);
+			continue;
+		}
+
+		kernel_failed = failed;
+
+		for (round = 0; round < NDM_SCAN_CHECK_ROUNDS; round++) {
+			set.n = (unsigned int) (1 + round % NDM_SCAN_SET_MAX);
+
+			for (i = 0; i < set.n; i++) {
+				set.c[i] = __ndm_scan_check_byte();
+			}
+
+			for (i = 0; i < sizeof(buf); i++) {
+				buf[i] = (char) __ndm_scan_check_byte();
+			}
+
+			for (off = 0; off <= NDM_SCAN_CHECK_LEN; off++) {
+				for (len = 0; len <= NDM_SCAN_CHECK_LEN; len++) {
+					const char *p = buf + off;
+					const char *end = p + len;
+					const char *expected = __ndm_scan_scalar(p, end, &set);
+					const char *found = c->fn(p, end, &set);
+
+					checked++;
+
+					if (found != expected) {
+						failed++;
+						fprintf(stderr,
+							"%s: offset %zu length %zu: %td instead of %td\n",
+							c->name, off, len, found - p, expected - p);
+					}
+				}
+			}
+		}
+
+		printf("%s: %s\n", c->name, failed == kernel_failed ? "ok" : "failed");
+	}
+
+	printf("selected %s, %lu checks, %lu failed\n",
+		   ndm_scan_kernel(), checked, failed);
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}